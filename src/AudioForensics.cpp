@@ -0,0 +1,168 @@
+//  AudioForensics.cpp :: Rolling capture of mix state for underrun post-mortems
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#include "AudioForensics.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+
+#include <ClanLib/core.h>
+#include <sndfile.h>
+
+double      AudioForensics::gHistory = 0.0;
+std::string AudioForensics::gPath    = "forensics";
+
+//! Time the writer thread sleeps between checks.
+static const std::chrono::milliseconds WRITER_PERIOD(50);
+
+static uint64_t now_ns()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()
+			).count();
+}
+
+AudioForensics::AudioForensics(size_t sample_rate, size_t frames, double seconds, std::string const &path)
+	: mRate      (sample_rate)
+	, mFrames    (std::max<size_t>(frames, 1))
+	, mPath      (path)
+	, mStart     (now_ns())
+	, mBlocks    ()
+	, mOutput    ()
+	, mFramesKept(std::max<size_t>(static_cast<size_t>(std::ceil(seconds * sample_rate)), mFrames))
+	, mBlockCount(0)
+	, mFrameCount(0)
+	, mPending   (false)
+	, mBlockEnd  (0)
+	, mFrameEnd  (0)
+	, mRunning   (true)
+	, mWriter    ()
+{
+	mBlocksKept = (mFramesKept + mFrames - 1) / mFrames;
+
+	// The audio thread keeps writing while a snapshot is copied out, so the
+	// rings hold twice what is written.
+	mBlocks.resize(mBlocksKept * 2);
+	mOutput.resize(mFramesKept * 2 * 2, 0.0f);
+
+	if (clan::FileHelp::file_exists(mPath) == false)
+		clan::Directory::create(mPath, true);
+
+	mWriter = std::thread(&AudioForensics::run, this);
+}
+
+AudioForensics::~AudioForensics()
+{
+	mRunning.store(false);
+	if (mWriter.joinable())
+		mWriter.join();
+}
+
+void AudioForensics::record(Block const &block, awe::AfBuffer const &output)
+{
+	uint64_t const b = mBlockCount.load(std::memory_order_relaxed);
+	mBlocks[b % mBlocks.size()] = block;
+	mBlockCount.store(b + 1, std::memory_order_release);
+
+	uint64_t const f      = mFrameCount.load(std::memory_order_relaxed);
+	size_t   const frames = output.size() / 2;
+	size_t   const ring   = mOutput.size() / 2;
+
+	for (size_t i = 0, p = f % ring; i < frames; i++, p = (p + 1) % ring) {
+		mOutput[p * 2    ] = output[i * 2    ];
+		mOutput[p * 2 + 1] = output[i * 2 + 1];
+	}
+	mFrameCount.store(f + frames, std::memory_order_release);
+}
+
+void AudioForensics::trigger()
+{
+	if (mPending.load(std::memory_order_acquire))
+		return;
+
+	mBlockEnd = mBlockCount.load(std::memory_order_acquire);
+	mFrameEnd = mFrameCount.load(std::memory_order_acquire);
+	mPending.store(true, std::memory_order_release);
+}
+
+void AudioForensics::run()
+{
+	while (mRunning.load())
+	{
+		if (mPending.load(std::memory_order_acquire)) {
+			write();
+			mPending.store(false, std::memory_order_release);
+		}
+
+		std::this_thread::sleep_for(WRITER_PERIOD);
+	}
+}
+
+void AudioForensics::write()
+{
+	// Copy out the history first; the audio thread overwrites it once it
+	// has recorded another full history past the trigger.
+	size_t const nblocks = static_cast<size_t>(std::min<uint64_t>(mBlockEnd, mBlocksKept));
+	size_t const nframes = static_cast<size_t>(std::min<uint64_t>(mFrameEnd, mFramesKept));
+
+	std::vector<Block> blocks(nblocks);
+	for (size_t i = 0; i < nblocks; i++)
+		blocks[i] = mBlocks[(mBlockEnd - nblocks + i) % mBlocks.size()];
+
+	size_t const  ring = mOutput.size() / 2;
+	awe::AfBuffer output(nframes * 2);
+	for (size_t i = 0; i < nframes; i++) {
+		size_t const p = (mFrameEnd - nframes + i) % ring;
+		output[i * 2    ] = mOutput[p * 2    ];
+		output[i * 2 + 1] = mOutput[p * 2 + 1];
+	}
+
+	if (mFrameCount.load(std::memory_order_acquire) - mFrameEnd > mFramesKept) {
+		fprintf(stderr, "AudioForensics [warn] History was overwritten before it could be saved.\n");
+		return;
+	}
+
+	char stamp[32];
+	std::time_t const t = std::time(nullptr);
+	std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", std::localtime(&t));
+
+	std::string const base = mPath + "/underrun-" + stamp;
+
+	// Block statistics
+	FILE* csv = fopen((base + ".csv").c_str(), "w");
+	if (csv == nullptr) {
+		fprintf(stderr, "AudioForensics [error] Could not write %s.csv.\n", base.c_str());
+		return;
+	}
+
+	double const deadline = mFrames * 1e6 / mRate;
+
+	fprintf(csv, "time_ms,queued_frames,voices,lock_wait_us,voice_us,mix_us,push_us,block_us,deadline_us,underruns,collectors\n");
+	for (Block const &b : blocks)
+		fprintf(csv, "%.3f,%u,%u,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%u,%u\n",
+				b.time / 1e6, b.queued, b.voices,
+				b.lockWait / 1e3, b.voiceTime / 1e3, b.mixTime / 1e3, b.pushTime / 1e3, b.blockTime / 1e3,
+				deadline, b.underruns, b.collectors);
+	fclose(csv);
+
+	// Master output
+	SF_INFO info = SF_INFO();
+	info.samplerate = static_cast<int>(mRate);
+	info.channels   = 2;
+	info.format     = SF_FORMAT_WAV | SF_FORMAT_FLOAT;
+
+	SNDFILE* wav = sf_open((base + ".wav").c_str(), SFM_WRITE, &info);
+	if (wav == nullptr) {
+		fprintf(stderr, "libsndfile [error] %s.wav: %s.\n", base.c_str(), sf_strerror(nullptr));
+		return;
+	}
+
+	sf_writef_float(wav, output.data(), static_cast<sf_count_t>(nframes));
+	sf_close(wav);
+
+	fprintf(stderr, "AudioForensics [info] Underrun snapshot of %zu blocks written to %s.{csv,wav}.\n",
+			nblocks, base.c_str());
+}
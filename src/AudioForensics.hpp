@@ -0,0 +1,97 @@
+//  AudioForensics.hpp :: Rolling capture of mix state for underrun post-mortems
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#ifndef AUDIO_FORENSICS_H
+#define AUDIO_FORENSICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "libawe/Define.hpp"
+
+/**
+ * Keeps the last few seconds of per-block engine statistics along with the
+ * master output, and writes both to disk when the output device reports
+ * an underrun.
+ *
+ * The audio thread only copies into preallocated rings. A snapshot is
+ * written by a background thread: a CSV file of block statistics and a
+ * WAV file of the output, named after the time of the underrun.
+ */
+class AudioForensics
+{
+public:
+	//! Statistics of one rendered block; times in nanoseconds.
+	struct Block
+	{
+		uint64_t    time;       //!< Time since the recorder was created.
+		uint32_t    queued;     //!< Frames queued for the device before rendering.
+		uint32_t    voices;     //!< Voices rendered.
+		uint32_t    lockWait;   //!< Waiting for the engine mutex.
+		uint32_t    voiceTime;  //!< Rendering voices.
+		uint32_t    mixTime;    //!< Pulling, filtering and flipping the tracks, and changing speed.
+		uint32_t    pushTime;   //!< Pushing the output, including waiting for the queue.
+		uint32_t    blockTime;  //!< The whole block.
+		uint32_t    underruns;  //!< Underruns reported by the device so far.
+		uint32_t    collectors; //!< Sample map collector threads running.
+	};
+
+	static double       gHistory;   //!< Seconds of history kept; zero disables the recorder.
+	static std::string  gPath;      //!< Directory snapshots are written to.
+
+	/**
+	 * \param sample_rate Output sampling rate.
+	 * \param frames      Frames per block.
+	 * \param seconds     Seconds of history written on each snapshot.
+	 * \param path        Directory to write snapshots to.
+	 */
+	AudioForensics(size_t sample_rate, size_t frames, double seconds, std::string const &path);
+	~AudioForensics();
+
+	AudioForensics(const AudioForensics&) = delete;
+	AudioForensics& operator=(const AudioForensics&) = delete;
+
+	inline uint64_t getStartTime() const { return mStart; }
+
+	/**
+	 * Adds a block and the output it produced. Called by the audio thread
+	 * only; does not lock or allocate.
+	 */
+	void record(Block const &block, awe::AfBuffer const &output);
+
+	/**
+	 * Requests a snapshot of the history up to the last recorded block.
+	 * Ignored while the previous snapshot is still being written.
+	 */
+	void trigger();
+
+private:
+	size_t                  mRate;
+	size_t                  mFrames;        //!< Frames per block.
+	std::string             mPath;
+
+	uint64_t                mStart;         //!< steady_clock time of creation in nanoseconds.
+
+	std::vector<Block>      mBlocks;        //!< Block ring; twice the history.
+	awe::AfBuffer           mOutput;        //!< Output ring; twice the history.
+	size_t                  mBlocksKept;    //!< Blocks written per snapshot.
+	size_t                  mFramesKept;    //!< Output frames written per snapshot.
+
+	std::atomic<uint64_t>   mBlockCount;    //!< Blocks recorded so far.
+	std::atomic<uint64_t>   mFrameCount;    //!< Output frames recorded so far.
+
+	std::atomic<bool>       mPending;       //!< Snapshot requested and not written yet.
+	uint64_t                mBlockEnd;      //!< Block count when the snapshot was requested.
+	uint64_t                mFrameEnd;      //!< Frame count when the snapshot was requested.
+
+	std::atomic<bool>       mRunning;
+	std::thread             mWriter;
+
+	void run();
+	void write();
+};
+
+#endif
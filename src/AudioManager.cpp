@@ -1,27 +1,104 @@
 #include "AudioManager.hpp"
+#include "AudioForensics.hpp"
+#include "AudioSpeed.hpp"
+#include "RealTime.hpp"
 #include "libawe/Filters/Mixer.hpp"
+#include "libawe/Log.hpp"
+#include "libawe/Profile.hpp"
+#include <algorithm>
 #include <chrono>
+#include <cstdio>
 #include <list>
+#include <set>
 
 #if !( defined(_WIN32) || defined(_WIN64) )
 #include <pthread.h> // POSIX Thread naming
 #endif
 
-AudioManager::AudioManager(size_t frame_count, size_t sample_rate)
-    : awe::AEngine(sample_rate, frame_count, awe::APortAudio::HostAPIType::Default)
+double AudioManager::gStreamThreshold = 0.0;
+double AudioManager::gStreamAhead     = 0.5;
+bool   AudioManager::gMatchSampleRate = false;
+bool   AudioManager::gFloatSamples    = false;
+bool   AudioManager::gPlanar          = false;
+double AudioManager::gPrepareAhead    = 0.0;
+double AudioManager::gProfilePeriod   = 0.0;
+double AudioManager::gSpeed           = 1.0;
+size_t AudioManager::gQueueMin        = 2;
+size_t AudioManager::gQueueMax        = 8;
+double AudioManager::gQueueShrinkAfter= 10.0;
+
+//  Layout of the blocks every track mixes into.
+static awe::Alayout mix_layout()
+{
+    return AudioManager::gPlanar ? awe::Alayout::PLANAR : awe::Alayout::INTERLEAVED;
+}
+
+//  Number of sample map collector threads running.
+static std::atomic<unsigned> gCollectors(0);
+
+//  Nanoseconds between two time points, clamped to 32 bits.
+static uint32_t elapsed(std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b)
+{
+    return static_cast<uint32_t>(std::min<int64_t>(UINT32_MAX,
+                std::chrono::duration_cast<std::chrono::nanoseconds>(b - a).count()));
+}
+
+//  Upper bound on the number of prepared voices.
+static const size_t kMaxPrepared = 128;
+
+//  Checks whether a voice was set up to play a given sample and gain.
+static bool matches(Voice const& v, Sample const* sample, Track const* track, awe::Asfloatf const& gain)
+{
+    return v.sample == sample && v.track == track && v.chanGain.data == gain.data;
+}
+
+//  Converts samples to the configured precision.
+static void prepare_Sample(Sample& sample)
+{
+    if (AudioManager::gFloatSamples)
+        sample.widen();
+}
+
+//  Memory a sample plays from, as locked by `lock_Samples`.
+static void const* sample_memory(Sample const& sample)
+{
+    return sample.isWidened()  ? static_cast<void const*>(sample.getFloat().get())
+         : sample.isStreamed() ? static_cast<void const*>(sample.cgetEncoded()->data())
+         :                       static_cast<void const*>(sample.getData().get());
+}
+
+AudioManager::AudioManager(size_t frame_count, size_t sample_rate, awe::APortAudio::HostAPIType device_type)
+    : awe::AEngine(sample_rate, frame_count, device_type, std::max(std::max<size_t>(gQueueMin, 1), gQueueMax), mix_layout())
     , mUpdateCount(0)
+    , mMixFrames(0)
+    , mMixNanos(0)
+    , mLastDump(std::chrono::steady_clock::now())
+    , mForensics()
+    , mForensicsHistory(0.0)
+    , mForensicsPath()
+    , mLastUnderruns(0)
+    , mQueueDepth(gQueueMin)
+    , mQueueUnderruns(0)
+    , mQueueChanged(std::chrono::steady_clock::now())
+    , mQueuePeak(0)
+    , mSpeed()
     // , mRunning(ATOMIC_FLAG_INIT)
 {
+    awe::Aprofiler::get().setDeadline(frame_count, sample_rate);
+    enable_Forensics(AudioForensics::gHistory, AudioForensics::gPath);
+
     mTrackMap.insert( {
-        { 0, new Track(sample_rate, frame_count, "Autoplay") },
-        { 1, new Track(sample_rate, frame_count, "Player 1") },
-        { 2, new Track(sample_rate, frame_count, "Player 2") }
+        { 0, new Track(sample_rate, frame_count, "Autoplay", mix_layout()) },
+        { 1, new Track(sample_rate, frame_count, "Player 1", mix_layout()) },
+        { 2, new Track(sample_rate, frame_count, "Player 2", mix_layout()) }
     });
 
     mMasterTrack.attach_source(mTrackMap[0]);
     mMasterTrack.attach_source(mTrackMap[1]);
     mMasterTrack.attach_source(mTrackMap[2]);
 
+    set_Speed(gSpeed, 0.0);
+
     mRunning.test_and_set();
 
     mThreads.push_back(
@@ -29,6 +106,7 @@ AudioManager::AudioManager(size_t frame_count, size_t sample_rate)
 #if !( defined(_WIN32) || defined(_WIN64) )
         pthread_setname_np(pthread_self(), "Audio Engine");
 #endif
+        RealTime::apply("Audio Engine");
         while (mRunning.test_and_set()) {
             if (this->update() == false) {
                 std::this_thread::sleep_for(std::chrono::milliseconds(1));
@@ -50,13 +128,27 @@ AudioManager::~AudioManager()
         mThreads.erase(it);
     }
 
+    mSpeed.reset();
     wipe_SampleMap(true);
 }
 
 void AudioManager::wipe_SampleMap(bool drop_data)
 {
+    //  Charts at normal speed go without the resampler and its delay; the
+    //  others start on a fresh one, without the tail of the previous chart.
+    //  Set it up outside of the lock the audio thread takes.
+    std::unique_ptr<AudioSpeed> fresh;
+    if (mSpeed && mSpeed->getSpeed() != 1.0)
+        fresh.reset(make_Speed(mOutputDevice.getSampleRate(), mSpeed->getSpeed()));
+
     std::lock_guard<std::mutex> lock(mMutex);
 
+    {
+        //  Prepared voices point into the outgoing sample map.
+        std::lock_guard<std::mutex> prepare_lock(mPrepareMutex);
+        mPrepared.clear();
+    }
+
     //  Swap collections
     VoiceList*  pVoiceList = new VoiceList();
     SampleMap*  pSampleMap = new SampleMap();
@@ -64,7 +156,14 @@ void AudioManager::wipe_SampleMap(bool drop_data)
     pVoiceList->swap(mVoiceList);
     pSampleMap->swap(mSampleMap);
 
+    mMixFrames = 0;
+    mMixNanos  = 0;
+    awe::Aprofiler::get().reset();
+
+    mSpeed.swap(fresh);
+
     //  Initialize garbage collector thread
+    gCollectors.fetch_add(1);
     std::thread gc([](VoiceList * vl, SampleMap * sm, bool drop) {
         while (vl->empty() == false) {
             vl->erase(vl->begin());
@@ -72,6 +171,12 @@ void AudioManager::wipe_SampleMap(bool drop_data)
 
         while (sm->empty() == false) {
             SampleMap::iterator it = sm->begin();
+
+            //  Unlock data nobody else holds before it is freed; locked
+            //  memory would otherwise pile up chart after chart.
+            if (it->second.hasData() && it->second.isUnshared())
+                RealTime::unlock(sample_memory(it->second), it->second.getMemoryUsage());
+
             if (drop) {
                 it->second.drop();
             }
@@ -81,6 +186,7 @@ void AudioManager::wipe_SampleMap(bool drop_data)
 
         delete vl;
         delete sm;
+        gCollectors.fetch_sub(1);
     },  pVoiceList, pSampleMap, drop_data
                   );
     gc.detach();
@@ -88,10 +194,322 @@ void AudioManager::wipe_SampleMap(bool drop_data)
 
 void AudioManager::swap_SampleMap(SampleMap& new_map)
 {
+    for (auto &pair : new_map)
+        prepare_Sample(pair.second);
+
     std::lock_guard<std::mutex> lock(mMutex);
     mSampleMap.swap(new_map);
 }
 
+void AudioManager::insert_Sample(unsigned int id, Sample const& sample)
+{
+    //  Convert outside the lock; the copy leaves the caller's sample as is.
+    Sample prepared = sample;
+    prepare_Sample(prepared);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mSampleMap.insert(SampleMap::value_type(id, prepared));
+}
+
+void AudioManager::insert_Samples(SampleMap const& samples)
+{
+    SampleMap prepared = samples;
+    for (auto &pair : prepared)
+        prepare_Sample(pair.second);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mSampleMap.insert(prepared.begin(), prepared.end());
+}
+
+size_t AudioManager::lock_Samples()
+{
+    if (RealTime::gLocking != RealTime::Locking::SAMPLES && RealTime::gPrefault == false)
+        return 0;
+
+    SampleMap samples = copy_SampleMap();
+
+    std::set<void const*> seen;
+    size_t locked = 0, total = 0;
+
+    for (auto const &pair : samples) {
+        Sample const &sample = pair.second;
+        void const *data = sample.hasData() ? sample_memory(sample) : nullptr;
+
+        if (data == nullptr || seen.insert(data).second == false)
+            continue;
+
+        locked += RealTime::lock(data, sample.getMemoryUsage());
+        total  += sample.getMemoryUsage();
+    }
+
+    fprintf(stderr, "AudioManager [info] Locked %.2f MiB of %.2f MiB of sample data.\n",
+            locked / 1048576.0, total / 1048576.0);
+    return locked;
+}
+
+SampleMap AudioManager::copy_SampleMap()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mSampleMap;
+}
+
+void AudioManager::set_Stem(Sample const& stem)
+{
+    Sample prepared = stem;
+    prepare_Sample(prepared);
+
+    if (prepared.isStreamed() == false)
+        RealTime::lock(sample_memory(prepared), prepared.getMemoryUsage());
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mSampleMap[STEM_SAMPLE_ID] = prepared;
+}
+
+bool AudioManager::play_Stem()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    SampleMap::iterator S = mSampleMap.find(STEM_SAMPLE_ID);
+    if (S == mSampleMap.end() || S->second.hasData() == false) {
+        return false;
+    }
+
+    awe::Asfloatf gain;
+    gain[0] = 1.0f;
+    gain[1] = 1.0f;
+
+    mVoiceList.push_back(Voice { & (S->second), mTrackMap[0], gain });
+    return true;
+}
+
+void AudioManager::prepare(NoteAudioList const& hints)
+{
+    struct Hint {
+        Sample*         sample;
+        Track*          track;
+        awe::Asfloatf   gain;
+        bool            ready;
+    };
+
+    std::vector<Hint> wanted;
+    size_t frames;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        frames = mMasterTrack.getConfig().frameCount;
+
+        for (NoteAudio const& note : hints) {
+            if (wanted.size() >= kMaxPrepared)
+                break;
+
+            TrackMap ::iterator T = mTrackMap .find(note.trackID);
+            SampleMap::iterator S = mSampleMap.find(note.sampleID);
+            if (T == mTrackMap.end() || S == mSampleMap.end() || S->second.hasData() == false)
+                continue;
+
+            wanted.push_back(Hint {
+                & (S->second), T->second,
+                awe::Filter::xSinCos(note.volume, note.panning),
+                false
+            });
+        }
+    }
+
+    //  Keep prepared voices that are still hinted at, one per hint.
+    {
+        std::lock_guard<std::mutex> prepare_lock(mPrepareMutex);
+        mPrepared.remove_if([&](Voice const &v) -> bool {
+            for (Hint &hint : wanted) {
+                if (hint.ready == false && matches(v, hint.sample, hint.track, hint.gain)) {
+                    hint.ready = true;
+                    return false;
+                }
+            }
+            return true;
+        });
+    }
+
+    //  Set up the rest outside of any lock the audio thread takes.
+    VoiceList fresh;
+    for (Hint const &hint : wanted) {
+        if (hint.ready)
+            continue;
+
+        fresh.push_back(Voice { hint.sample, hint.track, hint.gain });
+        fresh.back().prime(frames);
+    }
+
+    std::lock_guard<std::mutex> prepare_lock(mPrepareMutex);
+    mPrepared.splice(mPrepared.end(), fresh);
+}
+
+void AudioManager::enable_Forensics(double seconds, std::string const& path)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    mForensics.reset();
+    if (seconds > 0.0)
+        mForensics.reset(new AudioForensics(
+                    mOutputDevice.getSampleRate(), mMasterTrack.getConfig().frameCount, seconds, path
+                    ));
+
+    mForensicsHistory = seconds;
+    mForensicsPath    = path;
+    mLastUnderruns    = mOutputDevice.getUnderruns();
+}
+
+AudioSpeed* AudioManager::make_Speed(size_t sample_rate, double speed)
+{
+    return new AudioSpeed(sample_rate, mMasterTrack.getConfig().frameCount, mMasterTrack.getLayout(), speed,
+            [this]() -> awe::AfBuffer const& {
+                render_Mix();
+                return mMasterTrack.getOutput();
+            });
+}
+
+void AudioManager::set_Speed(double speed, double ramp)
+{
+    //  Only this thread replaces the speed stage; set it up outside of the
+    //  lock the audio thread takes.
+    std::unique_ptr<AudioSpeed> fresh;
+    if (mSpeed == nullptr && speed != 1.0)
+        fresh.reset(make_Speed(mOutputDevice.getSampleRate(), speed));
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (fresh)
+        mSpeed.swap(fresh);
+    else if (mSpeed)
+        mSpeed->setSpeed(speed, ramp);
+    else
+        return;
+
+    AWE_LOG(INFO, "AudioManager", "Playback speed set to %.2fx.", mSpeed->getSpeed());
+}
+
+double AudioManager::getSpeed() const
+{
+    return mSpeed ? mSpeed->getSpeed() : 1.0;
+}
+
+double AudioManager::getSpeedDelay() const
+{
+    return mSpeed ? mSpeed->getDelay() : 0.0;
+}
+
+size_t AudioManager::count_Voices()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mVoiceList.size();
+}
+
+void AudioManager::report_Samples()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    size_t bytes = 0, as_int16 = 0, as_float = 0, widened = 0;
+    for (auto const &pair : mSampleMap) {
+        Sample const &sample = pair.second;
+        bytes += sample.getMemoryUsage();
+
+        if (sample.isStreamed()) {
+            as_int16 += sample.getMemoryUsage();
+            as_float += sample.getMemoryUsage();
+        } else {
+            size_t const values = sample.getFrameCount() * sample.getChannelCount();
+            as_int16 += values * sizeof(awe::Aint  );
+            as_float += values * sizeof(awe::Afloat);
+            widened  += sample.isWidened() ? 1 : 0;
+        }
+    }
+
+    fprintf(stderr, "AudioManager [info] %zu samples (%zu as float32) use %.2f MiB; %.2f MiB as int16, %.2f MiB as float32.\n",
+            mSampleMap.size(), widened, bytes / 1048576.0, as_int16 / 1048576.0, as_float / 1048576.0);
+
+    if (mMixFrames != 0)
+        fprintf(stderr, "AudioManager [info] Rendered %llu voice frames at %.1f ns per frame.\n",
+                static_cast<unsigned long long>(mMixFrames), static_cast<double>(mMixNanos) / mMixFrames);
+}
+
+bool AudioManager::set_SampleRate(unsigned int sample_rate)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (awe::AEngine::set_SampleRate(sample_rate) == false)
+        return false;
+
+    awe::Aprofiler::get().setDeadline(mMasterTrack.getConfig().frameCount, sample_rate);
+
+    //  Underruns while the stream restarts say nothing about the load.
+    mQueueUnderruns = mOutputDevice.getUnderruns();
+    mQueueChanged   = std::chrono::steady_clock::now();
+    mQueuePeak      = 0;
+
+    //  Reopening the stream empties the queue; start a new history.
+    if (mForensics) {
+        mForensics.reset(new AudioForensics(
+                    sample_rate, mMasterTrack.getConfig().frameCount, mForensicsHistory, mForensicsPath
+                    ));
+        mLastUnderruns = mOutputDevice.getUnderruns();
+    }
+
+    if (mSpeed)
+        mSpeed.reset(make_Speed(sample_rate, mSpeed->getSpeed()));
+
+    //  Voices carry resamplers set up for the previous rate.
+    mVoiceList.clear();
+    {
+        std::lock_guard<std::mutex> prepare_lock(mPrepareMutex);
+        mPrepared.clear();
+    }
+
+    for (auto &pair : mTrackMap) {
+        awe::ArenderConfig config = pair.second->getConfig();
+        config.sampleRate = sample_rate;
+        pair.second->setConfig(config);
+    }
+
+    return true;
+}
+
+bool AudioManager::match_SampleRate()
+{
+    std::map< unsigned long, size_t > frames;
+    size_t total = 0;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (auto const &pair : mSampleMap) {
+            frames[pair.second.getSampleRate()] += pair.second.getFrameCount();
+            total += pair.second.getFrameCount();
+        }
+    }
+
+    if (frames.empty())
+        return false;
+
+    auto const dominant = std::max_element(frames.begin(), frames.end(),
+        [] (std::pair< const unsigned long, size_t > const &a,
+            std::pair< const unsigned long, size_t > const &b) -> bool {
+            return a.second < b.second;
+        });
+
+    unsigned int const rate = dominant->first;
+    if (rate == mOutputDevice.getSampleRate())
+        return true;
+
+    if (mOutputDevice.supports(rate) == false) {
+        fprintf(stderr, "AudioManager [info] Output device does not support %u Hz; keeping %u Hz.\n",
+                rate, mOutputDevice.getSampleRate());
+        return false;
+    }
+
+    if (set_SampleRate(rate) == false)
+        return false;
+
+    fprintf(stderr, "AudioManager [info] Output switched to %u Hz to match %.0f%% of sample data.\n",
+            rate, 100.0 * dominant->second / total);
+    return true;
+}
+
 bool AudioManager::play(NoteAudio const& note)
 {
     std::lock_guard<std::mutex> lock(mMutex);
@@ -134,10 +552,23 @@ size_t AudioManager::play(NoteAudioList const& notes)
 					return v.sample == &(S->second);
 				});
 
-        mVoiceList.push_back(Voice {
-            & (S->second), T->second,
-            awe::Filter::xSinCos(note.volume, note.panning)
-        });
+        awe::Asfloatf const gain = awe::Filter::xSinCos(note.volume, note.panning);
+
+        //  Take over a prepared voice if there is one.
+        {
+            std::lock_guard<std::mutex> prepare_lock(mPrepareMutex);
+            auto P = std::find_if(mPrepared.begin(), mPrepared.end(),
+                    [&](Voice const &v) -> bool { return matches(v, &(S->second), T->second, gain); }
+                    );
+
+            if (P != mPrepared.end()) {
+                mVoiceList.splice(mVoiceList.end(), mPrepared, P);
+                count += 1;
+                continue;
+            }
+        }
+
+        mVoiceList.push_back(Voice { & (S->second), T->second, gain });
 
         count += 1;
     }
@@ -148,29 +579,140 @@ size_t AudioManager::play(NoteAudioList const& notes)
 
 bool AudioManager::update()
 {
+    auto const waiting = std::chrono::steady_clock::now();
+
     std::lock_guard<std::mutex> lock(mMutex);
 
-    if (mOutputDevice.getFIFOBuffer().size() > mMasterTrack.getOutput().size()) {
+    //  Render only if the queue has room for another block
+    awe::AblockRing &queue  = mOutputDevice.getQueue();
+    awe::AfBuffer   *block  = queue.acquire();
+    size_t const     queued = queue.frames();
+    size_t const     frames = mMasterTrack.getConfig().frameCount;
+    if (block == nullptr || queued + frames > mQueueDepth.load(std::memory_order_relaxed) * frames) {
         return false;
     }
 
+    AWE_PROFILE_STAGE(BLOCK);
+
+    auto const begin = std::chrono::steady_clock::now();
+    size_t   const voices      = mVoiceList.size();
+    uint64_t const voice_nanos = mMixNanos;
+
+    //  Mix a block, or as many as the playback speed takes; the speed
+    //  stage writes straight into the queued block.
+    if (mSpeed)
+        mSpeed->render(*block);
+    else
+        render_Mix();
+
+    auto const mixed = std::chrono::steady_clock::now();
+
+    //  Hand the block over to the output device
+    {
+        AWE_PROFILE_STAGE(OUTPUT_PUSH);
+        if (mSpeed == nullptr)
+            mMasterTrack.take_output(*block);
+
+        queue.publish();
+    }
+
+    auto const pushed = std::chrono::steady_clock::now();
+
+    adapt_Queue(pushed, elapsed(begin, pushed));
+
+    //  Keep a history of this block and save it if the device ran dry
+    if (mForensics) {
+        unsigned long const underruns = mOutputDevice.getUnderruns();
+        uint32_t      const mix_time  = elapsed(begin, mixed);
+
+        AudioForensics::Block stats;
+        stats.time       = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                pushed.time_since_epoch()).count() - mForensics->getStartTime();
+        stats.queued     = static_cast<uint32_t>(queued);
+        stats.voices     = static_cast<uint32_t>(voices);
+        stats.lockWait   = elapsed(waiting , begin   );
+        stats.voiceTime  = static_cast<uint32_t>(std::min<uint64_t>(UINT32_MAX, mMixNanos - voice_nanos));
+        stats.mixTime    = mix_time - std::min(stats.voiceTime, mix_time);
+        stats.pushTime   = elapsed(mixed   , pushed  );
+        stats.blockTime  = elapsed(begin   , pushed  );
+        stats.underruns  = static_cast<uint32_t>(underruns);
+        stats.collectors = gCollectors.load(std::memory_order_relaxed);
+
+        mForensics->record(stats, *block);
+
+        if (underruns != mLastUnderruns) {
+            mLastUnderruns = underruns;
+            mForensics->trigger();
+        }
+    }
+
+    //  Write out stage timings every so often
+    if (gProfilePeriod > 0.0) {
+        auto const now = std::chrono::steady_clock::now();
+        if (now - mLastDump >= std::chrono::duration<double>(gProfilePeriod)) {
+            awe::Aprofiler::get().dump();
+            mLastDump = now;
+        }
+    }
+
+    return true;
+}
+
+void AudioManager::render_Mix()
+{
     //  Pull data from sample
+    auto const begin = std::chrono::steady_clock::now();
+
     for (Voice & v : mVoiceList) {
-        v.track->pull(&v);
+        AWE_PROFILE_STAGE(VOICE_RENDER);
+        awe::ArenderGraph::pull(*v.track, &v);
     }
 
+    auto const rendered = std::chrono::steady_clock::now();
+
+    mMixFrames += mVoiceList.size() * mMasterTrack.getConfig().frameCount;
+    mMixNanos  += std::chrono::duration_cast<std::chrono::nanoseconds>(rendered - begin).count();
+
     mVoiceList.remove_if([](Voice const & v) -> bool { return !v.is_active(); });
 
-    //  Pull data from tracks
-    mMasterTrack.pull();
-    mMasterTrack.flip();
+    //  Mix the tracks down to the master track
+    mGraph.run();
+}
+
+void AudioManager::adapt_Queue(std::chrono::steady_clock::time_point now, uint32_t block_time)
+{
+    size_t const lower = std::max<size_t>(gQueueMin, 1);
+    size_t const upper = std::max(gQueueMax, lower);
+    size_t       depth = std::min(std::max(mQueueDepth.load(std::memory_order_relaxed), lower), upper);
 
-    //  Push to output device buffer
-    mOutputDevice.getFIFOBuffer_mutex().lock();
-    mMasterTrack.push(mOutputDevice.getFIFOBuffer());
-    mOutputDevice.getFIFOBuffer_mutex().unlock();
+    unsigned long const underruns = mOutputDevice.getUnderruns();
+    bool const window_over = now - mQueueChanged >= std::chrono::duration<double>(gQueueShrinkAfter);
 
-    return true;
+    mQueuePeak = std::max(mQueuePeak, block_time);
+
+    awe::ArenderConfig const &config = mMasterTrack.getConfig();
+    double const block_ms = config.frameCount * 1000.0 / config.sampleRate;
+
+    if (underruns != mQueueUnderruns) {
+        mQueueUnderruns = underruns;
+        if (depth < upper) {
+            depth += 1;
+            AWE_LOG(INFO, "AudioManager", "Output underrun; queue raised to %zu blocks (%.1f ms).",
+                    depth, depth * block_ms);
+        }
+        mQueueChanged = now;
+        mQueuePeak    = 0;
+    } else if (window_over) {
+        if (depth > lower && mQueuePeak * 2.0 < block_ms * 1e6) {
+            depth -= 1;
+            AWE_LOG(INFO, "AudioManager", "Output stable; queue lowered to %zu blocks (%.1f ms).",
+                    depth, depth * block_ms);
+        }
+        mQueueChanged = now;
+        mQueuePeak    = 0;
+    }
+
+    mQueueDepth.store(depth, std::memory_order_relaxed);
 }
 
 void AudioManager::attach_thread(std::thread* thread_ptr)
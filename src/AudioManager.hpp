@@ -10,6 +10,8 @@
 #include <thread>
 #include <chrono>
 #include <atomic>
+#include <memory>
+#include <string>
 
 #include "Models/NoteAudio.h"
 #include "AudioVoice.hpp"
@@ -20,6 +22,9 @@
 #include "__zzCore.hpp"
 
 
+class AudioForensics;
+class AudioSpeed;
+
 using     VoiceList = std::list<     Voice >;
 using NoteAudioList = std::list< NoteAudio >;
 
@@ -46,11 +51,108 @@ private:
     TrackMap        mTrackMap;  //!< Maps an ID to a track.
     VoiceList       mVoiceList; //!< List of voices to render.
 
+    std::mutex      mPrepareMutex;  //!< Prepared voice list mutex
+    VoiceList       mPrepared;      //!< Voices primed ahead of their notes.
+
+    uint64_t        mMixFrames; //!< Voice frames rendered since the sample map was wiped.
+    uint64_t        mMixNanos;  //!< Time spent rendering those frames.
+
+    std::chrono::steady_clock::time_point mLastDump; //!< Last time stage timings were written out.
+
+    std::unique_ptr<AudioForensics> mForensics;         //!< Underrun history recorder, if enabled.
+    double                          mForensicsHistory;  //!< Seconds of history it keeps.
+    std::string                     mForensicsPath;     //!< Directory it writes snapshots to.
+    unsigned long                   mLastUnderruns;     //!< Device underruns seen so far.
+
+    std::atomic<size_t>                     mQueueDepth;        //!< Blocks kept queued for the device.
+    unsigned long                           mQueueUnderruns;    //!< Device underruns seen by `adapt_Queue`.
+    std::chrono::steady_clock::time_point   mQueueChanged;      //!< Start of the current observation window.
+    uint32_t                                mQueuePeak;         //!< Slowest block in that window, in nanoseconds.
+
+    std::unique_ptr<AudioSpeed> mSpeed; //!< Master speed stage; only set up once the speed leaves 1.
+
+    /**
+     * Renders every voice into its track, then mixes the tracks into the
+     * master track output.
+     */
+    void render_Mix();
+
+    //! Creates a master speed stage pulling blocks from `render_Mix`.
+    AudioSpeed* make_Speed(size_t sample_rate, double speed);
+
+    /**
+     * Grows the output queue by a block after an underrun, and shrinks it
+     * by one after `gQueueShrinkAfter` seconds without underruns in which
+     * every block rendered within half of its deadline.
+     */
+    void adapt_Queue(std::chrono::steady_clock::time_point now, uint32_t block_time);
+
 public:
+    /**
+     * Compressed samples longer than this many seconds are kept compressed
+     * in memory and decoded while they play; zero decodes every sample.
+     */
+    static double gStreamThreshold;
+
+    //! Number of seconds of audio decoded ahead of a streamed voice.
+    static double gStreamAhead;
+
+    /**
+     * Reopen the output device at the sampling rate used by most of a
+     * chart's sample data, so that those samples play without resampling.
+     */
+    static bool gMatchSampleRate;
+
+    /**
+     * Keep the PCM data of samples as floating point instead of 16-bit
+     * integers. This doubles their memory use, but lets samples at the
+     * output rate be mixed without any conversion.
+     */
+    static bool gFloatSamples;
+
+    /**
+     * Mix in planar blocks, one contiguous array per channel, so that
+     * per-channel filters vectorize. Blocks are interleaved only as they
+     * are handed to the output device.
+     */
+    static bool gPlanar;
+
+    //! Milliseconds ahead of a note to prepare its voice; zero disables it.
+    static double gPrepareAhead;
+
+    /**
+     * Number of blocks kept queued for the output device; also the lower
+     * bound when adapting the queue. Two blocks is the classic double
+     * buffering.
+     */
+    static size_t gQueueMin;
+
+    //! Upper bound of the adaptive output queue; at `gQueueMin` or below the queue is fixed.
+    static size_t gQueueMax;
+
+    //! Seconds without underruns before the output queue is shortened.
+    static double gQueueShrinkAfter;
+
+    /**
+     * Playback speed of the whole mix, for practice; 1 plays at normal
+     * speed. Pitch follows the speed.
+     */
+    static double gSpeed;
+
+    /**
+     * Seconds between writing out render stage timings, see
+     * `awe::Aprofiler`; zero disables timing.
+     */
+    static double gProfilePeriod;
+
     /**
      * Creates and initializes the game's audio system.
+     *
+     * \param device_type Output host; `Null` renders without a device,
+     *                    leaving output in its output queue.
      */
-    AudioManager(size_t frame_count = 4096, size_t sample_rate = 48000);
+    AudioManager(size_t frame_count = 4096, size_t sample_rate = 48000,
+            awe::APortAudio::HostAPIType device_type = awe::APortAudio::HostAPIType::Default);
     virtual ~AudioManager();
     virtual bool update();
 
@@ -60,12 +162,101 @@ public:
 
     inline TrackMap        * getTrackMap   ()       { return &mTrackMap; }
 
+    /**
+     * Keeps a history of per-block statistics and output, writing it to
+     * `path` whenever the output device underruns; see `AudioForensics`.
+     * Zero seconds disables it.
+     */
+    void enable_Forensics(double seconds, std::string const& path);
+
+    //! @return Number of blocks currently kept queued for the output device.
+    inline size_t getQueueDepth() const { return mQueueDepth.load(std::memory_order_relaxed); }
+
+    /**
+     * Changes the playback speed of the whole mix, moving to it over
+     * `ramp` seconds. The tracker clock should be given the same speed
+     * and ramp through `TClock::setSpeed` to stay in time with the audio.
+     */
+    void set_Speed(double speed, double ramp = 0.2);
+
+    //! @return Playback speed set last.
+    double getSpeed() const;
+
+    /**
+     * @return Seconds of music by which the speed stage delays the mix, or
+     *         zero without one. The tracker clock should be held back by
+     *         as much through `TClock::holdBack`.
+     */
+    double getSpeedDelay() const;
+
+    //! @return Number of voices currently playing.
+    size_t count_Voices();
+
     void wipe_SampleMap(bool drop_data = true);
     void swap_SampleMap(SampleMap& new_map);
 
+    /**
+     * Adds samples to the sample map while it is in use; existing samples
+     * with the same ID are left as they are.
+     */
+    void insert_Sample (unsigned int id, Sample const& sample);
+    void insert_Samples(SampleMap const& samples);
+
+    /**
+     * Locks the data of every sample into RAM and faults it in, as set up
+     * in `RealTime`. \return Number of bytes locked.
+     */
+    size_t lock_Samples();
+
+    //! @return A copy of the sample map, sharing the audio data.
+    SampleMap copy_SampleMap();
+
+    //! Sample ID holding the background stem; outside the range of chart sample IDs.
+    static constexpr unsigned int STEM_SAMPLE_ID = 0x10000;
+
+    /**
+     * Sets the background stem played by `play_Stem`. It is removed along
+     * with the rest of the sample map.
+     */
+    void set_Stem(Sample const& stem);
+
+    //! Starts playing the background stem at unity gain on the autoplay track.
+    bool play_Stem();
+
+    /**
+     * Changes the sampling rate of the output device and every track.
+     * Voices that are still playing are stopped.
+     */
+    virtual bool set_SampleRate(unsigned int sample_rate) override;
+
+    /**
+     * Switches the output device to the sampling rate holding the most
+     * frames of sample data in the sample map, if the device supports it.
+     *
+     * \return true if the output runs at that rate afterwards.
+     */
+    bool match_SampleRate();
+
+    /**
+     * Prints the memory used by the sample map, along with what it would
+     * use at either sample precision, and the time spent rendering voices
+     * since the sample map was last wiped.
+     */
+    void report_Samples();
+
     bool   play(NoteAudio     const&);
     size_t play(NoteAudioList const&);
 
+    /**
+     * Prepares voices for notes expected to be played soon, with their
+     * resamplers set up and first block rendered, so that playing them
+     * only moves them into the voice list.
+     *
+     * Each call replaces the previous set of hints; prepared voices not
+     * hinted at any more are dropped.
+     */
+    void prepare(NoteAudioList const& hints);
+
     static bool process_voice(Voice& v);
 
     void attach_thread(std::thread* thread_ptr);
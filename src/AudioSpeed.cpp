@@ -0,0 +1,98 @@
+//  AudioSpeed.cpp :: Variable-rate playback of the master mix
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#include "AudioSpeed.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include "soxr/src/soxr.h"
+
+#include "libawe/Log.hpp"
+
+constexpr double AudioSpeed::MIN_SPEED;
+constexpr double AudioSpeed::MAX_SPEED;
+
+static double clamp_speed(double speed)
+{
+	return std::min(std::max(speed, AudioSpeed::MIN_SPEED), AudioSpeed::MAX_SPEED);
+}
+
+AudioSpeed::AudioSpeed(size_t sample_rate, size_t frames, awe::Alayout layout, double speed, Source source)
+	: mSoxr   (nullptr)
+	, mRate   (sample_rate)
+	, mFrames (frames)
+	, mSource (source)
+	, mLayout (layout)
+	, mChannels()
+	, mTarget (clamp_speed(speed))
+	, mApplied(mTarget)
+	, mRamp   (0)
+{
+	soxr_error_t        error  = nullptr;
+	// Planar blocks go in as split channels; soxr interleaves its output.
+	soxr_io_spec_t      const soxIOs = soxr_io_spec(
+			layout == awe::Alayout::PLANAR ? SOXR_FLOAT32_S : SOXR_FLOAT32_I,
+			SOXR_FLOAT32_I
+			);
+	soxr_quality_spec_t const soxQs  = soxr_quality_spec(SOXR_HQ, SOXR_VR);
+	soxr_runtime_spec_t const soxRTs = soxr_runtime_spec(1);
+
+	// A variable-rate resampler takes the highest I/O ratio it will be
+	// set to as its rates.
+	mSoxr = soxr_create(MAX_SPEED, 1.0, 2, &error, &soxIOs, &soxQs, &soxRTs);
+	if (error) { throw std::runtime_error(error); }
+
+	error = soxr_set_io_ratio(mSoxr, mApplied, 0);
+	if (error == nullptr)
+		error = soxr_set_input_fn(mSoxr, &AudioSpeed::input, this, mFrames);
+
+	if (error) {
+		soxr_delete(mSoxr);
+		throw std::runtime_error(error);
+	}
+}
+
+AudioSpeed::~AudioSpeed()
+{
+	soxr_delete(mSoxr);
+}
+
+void AudioSpeed::setSpeed(double speed, double ramp)
+{
+	mTarget = clamp_speed(speed);
+	mRamp   = static_cast<size_t>(std::max(ramp, 0.0) * mRate);
+}
+
+void AudioSpeed::render(awe::AfBuffer &output)
+{
+	if (mApplied != mTarget) {
+		soxr_set_io_ratio(mSoxr, mTarget, mRamp);
+		mApplied = mTarget;
+	}
+
+	size_t const frames = std::min(mFrames, output.size() / 2);
+	size_t const done   = soxr_output(mSoxr, output.data(), frames);
+	if (done < frames) {
+		std::fill(output.begin() + done * 2, output.begin() + frames * 2, 0.0f);
+		AWE_LOG(WARN, "AudioSpeed", "Resampler gave %zu of %zu frames.", done, frames);
+	}
+}
+
+size_t AudioSpeed::input(void *self, void const **data, size_t)
+{
+	AudioSpeed* const speed = static_cast<AudioSpeed*>(self);
+
+	// Hand over a whole block; the resampler copies it before asking again.
+	awe::AfBuffer const &block  = speed->mSource();
+	size_t        const  frames = block.size() / 2;
+
+	if (speed->mLayout == awe::Alayout::PLANAR) {
+		speed->mChannels[0] = block.data();
+		speed->mChannels[1] = block.data() + frames;
+		*data = speed->mChannels;
+	} else {
+		*data = block.data();
+	}
+
+	return frames;
+}
@@ -0,0 +1,83 @@
+//  AudioSpeed.hpp :: Variable-rate playback of the master mix
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#ifndef AUDIO_SPEED_H
+#define AUDIO_SPEED_H
+
+#include <functional>
+
+#include "libawe/Define.hpp"
+
+struct soxr;
+
+/**
+ * Plays the whole mix faster or slower through a single variable-rate
+ * resampler, so that voices keep their own resamplers as they are.
+ * Pitch follows the speed, like a tape running at a different speed.
+ *
+ * Mixed blocks are pulled from a source function as the resampler needs
+ * them; at half speed one mixed block lasts two output blocks.
+ */
+class AudioSpeed
+{
+public:
+	//! Mixes the next block and returns the stereo output.
+	using Source = std::function< awe::AfBuffer const& () >;
+
+	static constexpr double MIN_SPEED = 0.25;
+	static constexpr double MAX_SPEED = 2.0;
+
+	/**
+	 * \param sample_rate Sampling rate of the mix and the output.
+	 * \param frames      Frames per block, both mixed and output.
+	 * \param layout      Layout of the mixed blocks; the output is
+	 *                    always interleaved.
+	 * \param speed       Initial speed, applied at once.
+	 * \param source      Function mixing the blocks to play.
+	 */
+	AudioSpeed(size_t sample_rate, size_t frames, awe::Alayout layout, double speed, Source source);
+	~AudioSpeed();
+
+	AudioSpeed(const AudioSpeed&) = delete;
+	AudioSpeed& operator=(const AudioSpeed&) = delete;
+
+	/**
+	 * Changes the speed, moving to it linearly over `ramp` seconds of
+	 * output. The speed is clamped to [MIN_SPEED, MAX_SPEED].
+	 */
+	void setSpeed(double speed, double ramp);
+
+	//! @return Speed set last; the output may still be ramping towards it.
+	inline double getSpeed() const { return mTarget; }
+
+	/**
+	 * @return Seconds of music by which the output trails the mix. The
+	 *         resampler reads a whole mixed block ahead of what it plays,
+	 *         at any speed; its own filter delay is compensated for.
+	 */
+	inline double getDelay() const { return static_cast<double>(mFrames) / mRate; }
+
+	/**
+	 * Renders one output block, pulling as many mixed blocks from the
+	 * source as the current speed takes.
+	 *
+	 * \param output Interleaved stereo buffer of one block to write to.
+	 */
+	void render(awe::AfBuffer &output);
+
+private:
+	struct soxr*    mSoxr;
+	size_t          mRate;
+	size_t          mFrames;
+	Source          mSource;
+	awe::Alayout    mLayout;
+	void const*     mChannels[2];   //!< Channels of the last planar block handed over.
+
+	double          mTarget;    //!< Speed set last.
+	double          mApplied;   //!< Speed handed to the resampler.
+	size_t          mRamp;      //!< Output frames to ramp over towards `mTarget`.
+
+	static size_t input(void *self, void const **data, size_t frames);
+};
+
+#endif
@@ -0,0 +1,106 @@
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include "AudioSpeed.hpp"
+
+static const size_t RATE   = 48000;
+static const size_t FRAMES = 1024;
+
+//! Silent mix that counts the frames it hands over and can carry an impulse.
+struct Mix
+{
+	awe::AfBuffer   block;
+	size_t          pulled;
+	bool            impulse;
+
+	Mix() : block(FRAMES * 2), pulled(0), impulse(false) { }
+
+	AudioSpeed::Source source()
+	{
+		return [this] () -> awe::AfBuffer const& {
+			std::fill(block.begin(), block.end(), 0.0f);
+			if (impulse) {
+				block[0] = block[1] = 1.0f;
+				impulse  = false;
+			}
+
+			pulled += FRAMES;
+			return block;
+		};
+	}
+};
+
+// A speed ramp moves the rate mixed blocks are pulled at over to the new speed.
+static void test_ramp()
+{
+	Mix mix;
+	AudioSpeed speed(RATE, FRAMES, awe::Alayout::INTERLEAVED, 1.0, mix.source());
+	awe::AfBuffer output(FRAMES * 2);
+
+	for (int i = 0; i < 10; i++)
+		speed.render(output);
+
+	// 0.1 seconds is just under five blocks.
+	speed.setSpeed(2.0, 0.1);
+	assert(speed.getSpeed() == 2.0);
+
+	size_t const before = mix.pulled;
+	for (int i = 0; i < 5; i++)
+		speed.render(output);
+
+	size_t const ramped = mix.pulled - before;
+	assert(ramped > 6 * FRAMES && ramped < 9 * FRAMES);
+
+	size_t const after = mix.pulled;
+	for (int i = 0; i < 20; i++)
+		speed.render(output);
+
+	size_t const full = mix.pulled - after;
+	assert(full >= 39 * FRAMES && full <= 41 * FRAMES);
+}
+
+// The output trails the mix by no more than the delay reported.
+static void test_delay()
+{
+	for (double const rate : { 1.0, 0.5, 1.5 })
+	{
+		Mix mix;
+		AudioSpeed speed(RATE, FRAMES, awe::Alayout::INTERLEAVED, rate, mix.source());
+		awe::AfBuffer output(FRAMES * 2);
+
+		size_t      played = 0, heard = 0;
+		awe::Afloat peak   = 0.0f;
+		for (int i = 0; i < 40; i++) {
+			// Start a note as the tracker would, ten blocks in.
+			if (i == 10)
+				mix.impulse = true;
+
+			speed.render(output);
+			for (size_t f = 0; f < FRAMES; f++)
+				if (output[f * 2] > peak) {
+					peak  = output[f * 2];
+					heard = played + f;
+				}
+
+			played += FRAMES;
+		}
+
+		assert(peak > 0.1f);
+
+		double const late = (heard - 10.0 * FRAMES) * rate;
+		assert(late <= speed.getDelay() * RATE + 4.0);
+
+		// A whole block ahead at normal speed.
+		if (rate == 1.0)
+			assert(std::fabs(late - speed.getDelay() * RATE) <= 4.0);
+	}
+}
+
+int main()
+{
+	test_ramp ();
+	test_delay();
+
+	fprintf(stdout, "AudioSpeed: all tests passed.\n");
+	return 0;
+}
@@ -0,0 +1,153 @@
+//  AudioStream.cpp :: Background decoding of streamed samples
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#include "AudioStream.hpp"
+#include "RealTime.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#if !( defined(_WIN32) || defined(_WIN64) )
+#include <pthread.h> // POSIX Thread naming
+#endif
+
+//! Number of frames decoded at a time.
+static size_t const BLOCK_FRAMES = 1024;
+
+AudioStream::AudioStream(Sample const &sample, size_t ahead)
+	: mDecoder  (sample)
+	, mChannels (std::max<awe::Achan>(1, mDecoder.getChannelCount()))
+	, mRing     ()
+	, mCapacity (std::max(ahead, BLOCK_FRAMES * 2))
+	, mWritten  (0)
+	, mRead     (0)
+	, mEnded    (mDecoder.good() == false)
+	, mSkip     (0)
+	, mBlock    (BLOCK_FRAMES * mChannels)
+{
+	mRing.resize(mCapacity * mChannels);
+}
+
+size_t AudioStream::fill(size_t blocks)
+{
+	size_t total = 0;
+
+	for (; blocks > 0 && mEnded == false; blocks--)
+	{
+		size_t const written = mWritten.load(std::memory_order_relaxed);
+		size_t const space   = mCapacity - (written - mRead.load(std::memory_order_acquire));
+		if (space < BLOCK_FRAMES)
+			break;
+
+		size_t const done = mDecoder.read(mBlock.data(), BLOCK_FRAMES);
+		if (done == 0) {
+			mEnded = true;
+			break;
+		}
+
+		// Copy into the ring, wrapping around its end.
+		size_t const head  = written % mCapacity;
+		size_t const first = std::min(done, mCapacity - head);
+
+		memcpy(&mRing[head * mChannels], mBlock.data(), first * mChannels * sizeof(awe::Afloat));
+		memcpy(&mRing[0], mBlock.data() + first * mChannels, (done - first) * mChannels * sizeof(awe::Afloat));
+
+		mWritten.store(written + done, std::memory_order_release);
+		total += done;
+	}
+
+	return total;
+}
+
+size_t AudioStream::read(awe::Afloat* output, size_t frames)
+{
+	size_t       read    = mRead.load(std::memory_order_relaxed);
+	size_t const written = mWritten.load(std::memory_order_acquire);
+
+	// Catch up on frames skipped over before handing any out.
+	size_t const dropped = std::min(mSkip, written - read);
+	mSkip -= dropped;
+	read  += dropped;
+
+	size_t const done  = mSkip > 0 ? 0 : std::min(frames, written - read);
+
+	size_t const tail  = read % mCapacity;
+	size_t const first = std::min(done, mCapacity - tail);
+
+	memcpy(output, &mRing[tail * mChannels], first * mChannels * sizeof(awe::Afloat));
+	memcpy(output + first * mChannels, &mRing[0], (done - first) * mChannels * sizeof(awe::Afloat));
+
+	mRead.store(read + done, std::memory_order_release);
+	return done;
+}
+
+AudioStreamer::AudioStreamer()
+	: mMutex  ()
+	, mStreams()
+	, mThread ()
+	, mRunning(false)
+{ }
+
+AudioStreamer::~AudioStreamer()
+{
+	mRunning = false;
+	if (mThread.joinable())
+		mThread.join();
+}
+
+AudioStreamer& AudioStreamer::get()
+{
+	static AudioStreamer streamer;
+	return streamer;
+}
+
+void AudioStreamer::attach(std::shared_ptr<AudioStream> const &stream)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mStreams.push_back(stream);
+
+	if (mRunning == false) {
+		mRunning = true;
+		mThread  = std::thread(&AudioStreamer::run, this);
+	}
+}
+
+void AudioStreamer::run()
+{
+#if !( defined(_WIN32) || defined(_WIN64) )
+	pthread_setname_np(pthread_self(), "Audio Streamer");
+#endif
+	RealTime::apply("Audio Streamer", true);
+
+	std::vector< std::shared_ptr<AudioStream> > streams;
+
+	while (mRunning)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+
+			// Drop streams whose voices are gone or which have been decoded in whole.
+			streams.clear();
+			for (auto it = mStreams.begin(); it != mStreams.end(); ) {
+				std::shared_ptr<AudioStream> stream = it->lock();
+				if (stream == nullptr || stream->decoded()) {
+					it = mStreams.erase(it);
+				} else {
+					streams.push_back(stream);
+					it++;
+				}
+			}
+		}
+
+		size_t decoded = 0;
+		for (auto &stream : streams)
+			decoded += stream->fill();
+
+		// Release streams outside the lock so their decoders close here.
+		streams.clear();
+
+		if (decoded == 0)
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	}
+}
@@ -0,0 +1,94 @@
+//  AudioStream.hpp :: Background decoding of streamed samples
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#ifndef AUDIO_STREAM_H
+#define AUDIO_STREAM_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "libawe/Sample.hpp"
+
+using Sample = awe::Asample;
+
+/**
+ * Ring buffer of decoded frames running ahead of a streamed voice.
+ *
+ * The stream decoder thread is the only writer and the voice rendering
+ * it is the only reader, so the ring needs no locking.
+ */
+class AudioStream
+{
+private:
+	awe::AsampleDecoder     mDecoder;
+	awe::Achan              mChannels;
+
+	std::vector<awe::Afloat> mRing;     //!< Interleaved decoded frames.
+	size_t                   mCapacity; //!< Ring capacity in frames.
+	std::atomic<size_t>      mWritten;  //!< Frames written since creation.
+	std::atomic<size_t>      mRead;     //!< Frames read since creation.
+	std::atomic<bool>        mEnded;    //!< Decoder has reached the end.
+	size_t                   mSkip;     //!< Frames to drop once decoded. Reader side only.
+
+	std::vector<awe::Afloat> mBlock;    //!< Decoder output staging buffer.
+
+public:
+	/** \param sample Streamed sample to decode.
+	 *  \param ahead  Number of frames to keep decoded ahead of the reader.
+	 */
+	AudioStream(Sample const &sample, size_t ahead);
+
+	inline awe::Achan getChannelCount() const { return mChannels; }
+
+	//! @return true once the decoder has reached the end.
+	inline bool decoded() const { return mEnded; }
+
+	//! @return true once every decoded frame has been read.
+	inline bool ended() const { return mEnded && mRead == mWritten; }
+
+	/** Decodes frames into the free part of the ring. Decoder side only.
+	 *  \param blocks Maximum number of blocks to decode.
+	 *  \return Number of frames decoded.
+	 */
+	size_t fill(size_t blocks = SIZE_MAX);
+
+	/** Moves decoded frames out of the ring. Reader side only.
+	 *  \return Number of frames read; less than requested on underrun.
+	 */
+	size_t read(awe::Afloat* output, size_t frames);
+
+	/** Drops the next frames as soon as they are decoded, for a reader
+	 *  that has played silence in their place. Reader side only.
+	 */
+	inline void skip(size_t frames) { mSkip += frames; }
+};
+
+/**
+ * Background thread keeping every live `AudioStream` filled.
+ */
+class AudioStreamer
+{
+private:
+	std::mutex                                 mMutex;
+	std::vector< std::weak_ptr<AudioStream> >  mStreams;
+	std::thread                                mThread;
+	std::atomic<bool>                          mRunning;
+
+	AudioStreamer();
+	void run();
+
+public:
+	~AudioStreamer();
+
+	//! @return The process-wide stream decoder.
+	static AudioStreamer& get();
+
+	//! Registers a stream for background decoding, starting the thread if needed.
+	void attach(std::shared_ptr<AudioStream> const &stream);
+};
+
+#endif
@@ -0,0 +1,87 @@
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include "AudioStream.hpp"
+
+static const size_t FRAMES = 8192;
+
+//! @return Stereo 16-bit WAV file whose frame `i` holds `i % 32768` on both channels.
+static std::shared_ptr<const std::vector<char> > make_wav()
+{
+	auto wav = std::make_shared< std::vector<char> >(44 + FRAMES * 4);
+	char* p = wav->data();
+
+	auto put32 = [&p] (uint32_t v) { for (int i = 0; i < 4; i++) *p++ = char(v >> (8 * i)); };
+	auto put16 = [&p] (uint16_t v) { for (int i = 0; i < 2; i++) *p++ = char(v >> (8 * i)); };
+
+	memcpy(p, "RIFF", 4); p += 4; put32(36 + FRAMES * 4);
+	memcpy(p, "WAVE", 4); p += 4;
+	memcpy(p, "fmt ", 4); p += 4; put32(16);
+	put16(1); put16(2); put32(44100); put32(44100 * 4); put16(4); put16(16);
+	memcpy(p, "data", 4); p += 4; put32(FRAMES * 4);
+
+	for (size_t i = 0; i < FRAMES; i++) {
+		put16(uint16_t(i % 32768));
+		put16(uint16_t(i % 32768));
+	}
+
+	return wav;
+}
+
+static Sample make_sample()
+{
+	Sample sample;
+	sample.setEncoded(make_wav(), FRAMES);
+	return sample;
+}
+
+//! @return Frame number held by a decoded frame.
+static size_t frame_of(awe::Afloat const* frame)
+{
+	return static_cast<size_t>(frame[0] * 32768.0f + 0.5f);
+}
+
+// A reader that played silence over a starved decoder resumes on time.
+static void test_starved()
+{
+	AudioStream stream(make_sample(), FRAMES);
+	std::vector<awe::Afloat> buffer(512 * 2);
+
+	// Nothing is decoded yet; the reader plays silence for 512 frames.
+	size_t const starved = stream.read(buffer.data(), 512);
+	assert(starved == 0);
+	stream.skip(512);
+
+	// One block later, the frames played over are dropped.
+	stream.fill(1);
+	size_t const done = stream.read(buffer.data(), 512);
+	assert(done == 512);
+	assert(frame_of(&buffer[0]) == 512);
+	assert(frame_of(&buffer[511 * 2]) == 1023);
+}
+
+// Frames skipped near the end shorten the stream instead of delaying it.
+static void test_tail()
+{
+	AudioStream stream(make_sample(), FRAMES);
+	std::vector<awe::Afloat> buffer(FRAMES * 2);
+
+	stream.skip(FRAMES - 100);
+	stream.fill();
+
+	size_t const done = stream.read(buffer.data(), FRAMES);
+	assert(done == 100);
+	assert(frame_of(&buffer[0]) == FRAMES - 100);
+
+	stream.fill();
+	assert(stream.ended());
+}
+
+int main()
+{
+	test_starved();
+	test_tail   ();
+
+	fprintf(stdout, "AudioStream: all tests passed.\n");
+	return 0;
+}
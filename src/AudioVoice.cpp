@@ -3,30 +3,61 @@
 
 #include "AudioVoice.hpp"
 
+#include <algorithm>
 #include <cstdio>
 #include "soxr/src/soxr.h"
 
+#include "AudioManager.hpp"
+#include "AudioStream.hpp"
+
 size_t soxr_input_fn(SoXR*, soxr_cbuf_t*, size_t);
 
 struct SoXR {
 	soxr_t          soxr;
 	soxr_error_t    soxr_error;
 
-	std::shared_ptr<awe::AiBuffer>
+	std::shared_ptr<const awe::Aint>
 				iptr; //!< Input pointer
+	std::shared_ptr<const awe::Afloat>
+				fptr; //!< Input pointer; replaces the input pointer on widened samples.
+	std::shared_ptr<AudioStream>
+				strm; //!< Input stream; replaces the input pointer on streamed samples.
+	std::vector<awe::Afloat>
+				sbuf; //!< Input buffer for frames read from the input stream.
 	size_t      chan; //!< Number of channels in sound sample.
 	size_t      size; //!< Number frames in sound sample to play.
 	size_t      read; //!< Number of frames read from input buffer.
+	bool        sync; //!< Decode the input stream on demand instead of in the background.
 
-	SoXR(Sample* sample, unsigned long output_sample_rate)
+	SoXR(Sample* sample, unsigned long output_sample_rate, bool synchronous)
 		: soxr(0)
 		, soxr_error(nullptr)
-		, iptr(sample->getSource())
+		, iptr(sample->getData())
+		, fptr(sample->getFloat())
+		, strm(nullptr)
+		, sbuf()
 		, chan(sample->getChannelCount())
 		, size(sample->getFrameCount())
 		, read(0)
+		, sync(synchronous)
 	{
-		soxr_io_spec_t      const soxIOs = soxr_io_spec(SOXR_INT16_I, SOXR_FLOAT32_I);
+		if (sample->isStreamed()) {
+			strm = std::make_shared<AudioStream>(*sample,
+					static_cast<size_t>(AudioManager::gStreamAhead * sample->getSampleRate())
+					);
+			sbuf.resize(IO_BUFFER_SIZE * chan);
+
+			// Have the first block ready before the voice starts rendering.
+			strm->fill(1);
+			if (sync == false)
+				AudioStreamer::get().attach(strm);
+		}
+
+		// Samples at the output rate are copied straight through.
+		if (sample->getSampleRate() == output_sample_rate)
+			return;
+
+		soxr_io_spec_t      const soxIOs = soxr_io_spec(strm || fptr ? SOXR_FLOAT32_I : SOXR_INT16_I, SOXR_FLOAT32_I);
 		soxr_quality_spec_t const soxQs  = soxr_quality_spec(
 				// This ternary statement is a temporary workaround for a crashing bug in SoXR 0.1.1.
 				// http://sourceforge.net/p/soxr/discussion/general/thread/29cfb185
@@ -58,7 +89,40 @@ struct SoXR {
 
 size_t soxr_input_fn(SoXR* ptr, soxr_cbuf_t* buf, size_t len)
 {
-	*buf = (ptr->iptr->data() + (ptr->read * ptr->chan));
+	if (ptr->strm) {
+		len = std::min(len, ptr->size - std::min(ptr->read, ptr->size));
+
+		size_t done = ptr->strm->read(ptr->sbuf.data(), len);
+
+		while (ptr->sync && done < len && ptr->strm->decoded() == false) {
+			size_t const got = ptr->strm->fill(1);
+			done += ptr->strm->read(ptr->sbuf.data() + done * ptr->chan, len - done);
+			if (got == 0)
+				break;
+		}
+
+		if (done < len) {
+			if (ptr->strm->ended()) {
+				// Decoder gave fewer frames than the sample claimed to have.
+				ptr->read = ptr->size - done;
+				len = done;
+			} else {
+				// Decoder fell behind; play silence in place of the missing
+				// frames and drop them once decoded, so the rest stays on time.
+				std::fill(ptr->sbuf.begin() + done * ptr->chan, ptr->sbuf.begin() + len * ptr->chan, 0.0f);
+				ptr->strm->skip(len - done);
+			}
+		}
+
+		*buf = ptr->sbuf.data();
+		ptr->read += len;
+		return len;
+	}
+
+	if (ptr->fptr)
+		*buf = (ptr->fptr.get() + (ptr->read * ptr->chan));
+	else
+		*buf = (ptr->iptr.get() + (ptr->read * ptr->chan));
 
 	/****/ if (ptr->read >= ptr->size) {
 		len = 0;
@@ -72,60 +136,188 @@ size_t soxr_input_fn(SoXR* ptr, soxr_cbuf_t* buf, size_t len)
 	return len;
 }
 
-Voice::Voice(Sample* _sample, Track* _track, awe::Asfloatf _gain)
+//! Reads frames without resampling, converting them to floating point.
+size_t direct_output(SoXR* ptr, awe::Afloat* out, size_t len)
+{
+	size_t done = 0;
+
+	while (done < len)
+	{
+		soxr_cbuf_t buf;
+		size_t const got = soxr_input_fn(ptr, &buf, std::min<size_t>(len - done, IO_BUFFER_SIZE));
+		if (got == 0)
+			break;
+
+		size_t const count = got * ptr->chan;
+		awe::Afloat* dst = out + done * ptr->chan;
+
+		if (ptr->strm || ptr->fptr) {
+			awe::Afloat const* src = static_cast<awe::Afloat const*>(buf);
+			std::copy(src, src + count, dst);
+		} else {
+			awe::Aint const* src = static_cast<awe::Aint const*>(buf);
+			for (size_t i = 0; i < count; i++)
+				dst[i] = awe::to_Afloat(src[i]);
+		}
+
+		done += got;
+	}
+
+	return done;
+}
+
+//! Renders frames from the resampler, or straight from the sample if there is none.
+size_t voice_output(SoXR* ptr, awe::Afloat* out, size_t len)
+{
+	if (ptr->soxr == 0)
+		return direct_output(ptr, out, len);
+
+	size_t const done = soxr_output(ptr->soxr, out, len);
+	ptr->soxr_error = soxr_error(ptr->soxr);
+	if (ptr->soxr_error) { throw std::runtime_error(ptr->soxr_error); }
+
+	return done;
+}
+
+/** Adds `len` frames of mono or stereo data, times the channel gains,
+ *  onto a stereo view whose frame step is `Step`. With the step known
+ *  here these loops carry no conversion and vectorize.
+ */
+template< size_t Step >
+static void gain_mix(awe::Afloat const* src, size_t chan, awe::AscView const &out, size_t len, awe::Afloat gl, awe::Afloat gr)
+{
+	awe::Afloat* const l = out.channel(0);
+	awe::Afloat* const r = out.channel(1);
+
+	if (chan == 2) {
+		for (size_t i = 0; i < len; i++) {
+			l[i*Step] += src[i*2  ] * gl;
+			r[i*Step] += src[i*2+1] * gr;
+		}
+	} else if (chan == 1) {
+		for (size_t i = 0; i < len; i++) {
+			l[i*Step] += src[i] * gl;
+			r[i*Step] += src[i] * gr;
+		}
+	}
+}
+
+static void gain_mix(awe::Afloat const* src, size_t chan, awe::AscView const &out, size_t len, awe::Afloat gl, awe::Afloat gr)
+{
+	len = std::min(len, out.frames());
+
+	if (out.isPlanar())
+		gain_mix<1>(src, chan, out, len, gl, gr);
+	else
+		gain_mix<2>(src, chan, out, len, gl, gr);
+}
+
+/** Mixes frames of a widened sample straight onto a stereo view.
+ *  Peak compensation is already part of the data, so only the channel
+ *  gains are applied.
+ */
+size_t direct_mix(SoXR* ptr, awe::AscView const &out, size_t len, awe::Asfloatf gain)
+{
+	len = std::min(len, ptr->size - std::min(ptr->read, ptr->size));
+	len = std::min(len, out.frames());
+
+	gain_mix(ptr->fptr.get() + ptr->read * ptr->chan, ptr->chan, out, len, gain[0], gain[1]);
+
+	ptr->read += len;
+	return len;
+}
+
+Voice::Voice(Sample* _sample, Track* _track, awe::Asfloatf _gain, bool _offline)
 	: sample    (_sample)
 	, track     (_track )
 	, chanGain  (_gain  )
-	, soxr      (std::make_shared<SoXR>(sample, track->getConfig().sampleRate))
+	, soxr      (std::make_shared<SoXR>(sample, track->getConfig().sampleRate, _offline))
+	, primed    ()
+	, primedRead(0)
 { }
 
 Voice::~Voice () {
 	soxr.reset();
 }
 
+void Voice::prime(size_t frames)
+{
+	awe::AfBuffer block(frames * 2, 0.f);
+	render(block, awe::ArenderConfig(track->getConfig().sampleRate, frames));
+
+	primed.swap(block);
+	primedRead = 0;
+}
+
 void Voice::drop() { }
 
 void Voice::make_active(void*) {
-	soxr = std::make_shared<SoXR>(sample, track->getConfig().sampleRate);
+	soxr = std::make_shared<SoXR>(sample, track->getConfig().sampleRate, soxr->sync);
+	primed.clear();
+	primedRead = 0;
 }
 
 bool Voice::  is_active() const {
-	return soxr->read < soxr->size;
+	return primedRead < primed.size() || soxr->read < soxr->size;
 }
 
 void Voice::render(awe::AfBuffer& buffer, const awe::ArenderConfig& config)
 {
-	awe::AfBuffer oBuffer(buffer.size(), 0.f);
+	if (primedRead < primed.size() && config.quality != awe::ArenderConfig::Quality::SKIP)
+	{
+		size_t const count = std::min<size_t>(config.frameCount, (primed.size() - primedRead) / 2);
+
+		if (config.quality != awe::ArenderConfig::Quality::MUTE) {
+			awe::mix(
+					awe::AscCView::interleaved(primed.data() + primedRead, count),
+					awe::AscView::target(buffer, config)
+					);
+		}
+
+		primedRead += count * 2;
+		if (primedRead == primed.size()) {
+			primed.clear();
+			primedRead = 0;
+		}
+
+		if (count == config.frameCount)
+			return;
+
+		render(buffer, awe::ArenderConfig(
+					config.sampleRate, config.frameCount - count,
+					config.frameOffset + count, config.quality, config.layout
+					));
+		return;
+	}
+
+	// Widened samples at the output rate are mixed straight from their data.
+	bool const direct = soxr->soxr == 0 && soxr->fptr;
 
 	switch (config.quality)
 	{
 	case awe::ArenderConfig::Quality::MUTE:
-		soxr_output(soxr->soxr, oBuffer.data(), config.frameCount);
-		soxr->soxr_error = soxr_error(soxr->soxr);
-		if (soxr->soxr_error) { throw std::runtime_error(soxr->soxr_error); }
+		if (direct) {
+			soxr->read += std::min<size_t>(config.frameCount, soxr->size - std::min(soxr->read, soxr->size));
+		} else {
+			awe::AfBuffer oBuffer(buffer.size(), 0.f);
+			voice_output(soxr.get(), oBuffer.data(), config.frameCount);
+		}
 
 	case awe::ArenderConfig::Quality::SKIP:
 		return;
 
 	default:
-		size_t oDone = soxr_output(soxr->soxr, oBuffer.data(), config.frameCount);
-		soxr->soxr_error = soxr_error(soxr->soxr);
-		if (soxr->soxr_error) { throw std::runtime_error(soxr->soxr_error); }
-
-		/****/ if (sample->getChannelCount() == 2) {
-			for (size_t i = 0; i < oDone; i++) {
-				size_t j = config.frameOffset + i;
-				buffer.data() [j*2  ] += oBuffer[i*2  ] * chanGain[0] * sample->getPeak();
-				buffer.data() [j*2+1] += oBuffer[i*2+1] * chanGain[1] * sample->getPeak();
-			}
-		} else if (sample->getChannelCount() == 1) {
-			for (size_t i = 0; i < oDone; i++) {
-				size_t j = config.frameOffset + i;
-				buffer.data() [j*2  ] += oBuffer[i  ] * chanGain[0] * sample->getPeak();
-				buffer.data() [j*2+1] += oBuffer[i  ] * chanGain[1] * sample->getPeak();
-			}
+		if (direct) {
+			direct_mix(soxr.get(), awe::AscView::target(buffer, config), config.frameCount, chanGain);
+			return;
 		}
 
+		awe::AfBuffer oBuffer(buffer.size(), 0.f);
+		size_t oDone = voice_output(soxr.get(), oBuffer.data(), config.frameCount);
+
+		gain_mix(oBuffer.data(), sample->getChannelCount(), awe::AscView::target(buffer, config), oDone,
+				chanGain[0] * sample->getPeak(), chanGain[1] * sample->getPeak());
+
 		return;
 	}
 }
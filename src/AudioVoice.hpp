@@ -26,9 +26,20 @@ public:
 private:
 	std::shared_ptr<SoXR> soxr;
 
+	awe::AfBuffer   primed;     //!< Stereo frames rendered ahead by `prime`.
+	size_t          primedRead; //!< Number of values taken from the primed buffer.
+
 public:
-	Voice(Sample* _sample, Track* _track, awe::Asfloatf _gain);
+	/** \param _offline Render faster than real time: streamed samples are
+	 *                  decoded on demand instead of in the background.
+	 */
+	Voice(Sample* _sample, Track* _track, awe::Asfloatf _gain, bool _offline = false);
 	virtual ~Voice();
+	/** Renders the first frames of this voice ahead of time, so that the
+	 *  block starting it only copies them out.
+	 */
+	void prime(size_t frames);
+
 	virtual void drop();
 	virtual void make_active(void*);
 	virtual bool is_active() const;
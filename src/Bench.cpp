@@ -0,0 +1,520 @@
+//  Bench.cpp :: Microbenchmarks for libawe and the game models
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "AudioManager.hpp"
+#include "AudioVoice.hpp"
+#include "libawe/Filters/3BEQ.hpp"
+#include "libawe/Filters/IIR.hpp"
+#include "libawe/Filters/Maximizer.hpp"
+#include "libawe/Filters/Metering.hpp"
+#include "libawe/Filters/Mixer.hpp"
+#include "libawe/Profile.hpp"
+#include "Models/EventNoteInstance.hpp"
+#include "Models/Sequence.hpp"
+
+//! Output sampling rate every benchmark runs at.
+static const size_t RATE  = 48000;
+
+//! Frames per block, as in the default `audio.frame-rate`.
+static const size_t BLOCK = 1024;
+
+//! Minimum time spent measuring each benchmark, in seconds.
+static double gMinTime = 0.5;
+
+//! Only benchmarks whose name contains this are run.
+static std::string gFilter;
+
+//! Run the microbenchmarks; off when only stress testing.
+static bool gBenchmarks = true;
+
+struct Result
+{
+	std::string name;
+	std::string params;
+	std::string unit;   //!< What is counted, e.g. "frame".
+	uint64_t    count;  //!< Units processed while measured.
+	double      nanos;  //!< Time spent processing them.
+};
+
+static std::vector<Result> gResults;
+
+//! Polyphony stress test settings.
+struct StressConfig
+{
+	bool                        enabled     = false;
+	double                      length      = 2.0;      //!< Seconds of audio in each sample.
+	std::vector<unsigned long>  rates       = { 44100 };//!< Sampling rates of the samples.
+	double                      retrigger   = 4.0;      //!< Times per second each voice restarts.
+	size_t                      blocks      = 200;      //!< Blocks rendered per polyphony level.
+	size_t                      limit       = 4096;     //!< Highest polyphony tried.
+	bool                        widen       = false;    //!< Use float32 sample data.
+};
+
+//! Block render times at one polyphony level.
+struct StressLevel
+{
+	size_t              voices;     //!< Voices requested.
+	double              playing;    //!< Mean number of voices playing.
+	awe::AstageSummary  block;      //!< Block render times.
+	bool                sustained;  //!< p99 block time is within the deadline.
+};
+
+static StressConfig             gStress;
+static std::vector<StressLevel> gStressLevels;
+static size_t                   gStressMax = 0;
+
+/** Measures a benchmark until `gMinTime` has been spent in `call`.
+ *
+ *  \param units Units processed by each call.
+ *  \param reset Restores inputs before each call; not timed.
+ */
+template<typename Call, typename Reset>
+static void measure(
+		std::string const &name, std::string const &params, std::string const &unit,
+		size_t units, Call call, Reset reset)
+{
+	if (name.find(gFilter) == std::string::npos)
+		return;
+
+	using clock = std::chrono::steady_clock;
+
+	for (int i = 0; i < 16; i++) {
+		reset();
+		call();
+	}
+
+	Result r { name, params, unit, 0, 0.0 };
+	while (r.nanos < gMinTime * 1e9)
+	{
+		reset();
+		auto const begin = clock::now();
+		call();
+		r.nanos += std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - begin).count();
+		r.count += units;
+	}
+
+	fprintf(stderr, "%-12s %-28s %10.2f ns/%s\n", name.c_str(), params.c_str(), r.nanos / r.count, unit.c_str());
+	gResults.push_back(r);
+}
+
+//! Stereo white noise at about -6 dBFS.
+static awe::AfBuffer noise(size_t frames, unsigned seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> dist(-0.5f, 0.5f);
+
+	awe::AfBuffer buffer(frames * 2);
+	for (awe::Afloat &v : buffer)
+		v = dist(rng);
+
+	return buffer;
+}
+
+//! Sample of stereo noise at the given rate.
+static Sample make_sample(unsigned long rate, double seconds, bool widen)
+{
+	awe::AfBuffer const src = noise(static_cast<size_t>(rate * seconds), static_cast<unsigned>(rate));
+
+	auto pcm = std::make_shared<awe::AiBuffer>(src.size());
+	for (size_t i = 0; i < src.size(); i++)
+		(*pcm)[i] = awe::to_Aint(src[i]);
+
+	Sample sample(pcm, 2, 1.0f, rate, "Bench noise");
+	if (widen)
+		sample.widen();
+
+	return sample;
+}
+
+template<typename Filter>
+static void bench_filter(std::string const &name, std::string const &params, Filter &filter)
+{
+	awe::AfBuffer const input = noise(BLOCK, 1);
+	awe::AfBuffer       buffer(input);
+
+	measure(name, params, "frame", BLOCK,
+			[&]() { filter.filter_buffer(buffer); },
+			[&]() { std::copy(input.begin(), input.end(), buffer.begin()); }
+		   );
+
+	// The same noise, one channel after the other.
+	awe::AscView const view = awe::AscView::planar(buffer.data(), BLOCK);
+
+	measure(name, params.empty() ? "planar" : params + ", planar", "frame", BLOCK,
+			[&]() { filter.filter_view(view); },
+			[&]() { awe::copy(awe::AscCView::interleaved(input.data(), BLOCK), view); }
+		   );
+}
+
+static void bench_filters()
+{
+	{
+		awe::Filter::AscMixer<2> mixer(0.8f, 0.25f);
+		bench_filter("AscMixer", "sincos", mixer);
+	}
+	{
+		awe::Filter::AscMixer<2> mixer(0.8f, 0.25f, awe::Filter::AscMixer<2>::IEType::LINEAR);
+		bench_filter("AscMixer", "linear", mixer);
+	}
+	{
+		awe::Filter::Maximizer<2> maximizer(RATE, awe::from_dBFS(6.0f));
+		bench_filter("Maximizer", "boost 6 dB", maximizer);
+	}
+	{
+		awe::Filter::TBEQ<2> eq(RATE, 600.0, 8000.0, 1.2, 1.0, 0.8);
+		bench_filter("TBEQ", "600 Hz / 8 kHz", eq);
+	}
+	{
+		awe::Filter::AscMetering meter(RATE / 2, 1.0);
+		bench_filter("AscMetering", "", meter);
+	}
+	if (std::string("IIR").find(gFilter) != std::string::npos)
+	{
+		awe::Filter::IIR::IIR<2> lpf(awe::Filter::IIR::newLPF(RATE, 880.0));
+		awe::AfBuffer const input = noise(BLOCK, 1);
+		awe::AfBuffer       buffer(input);
+
+		measure("IIR", "low-pass 880 Hz", "frame", BLOCK,
+				[&]() { lpf.process(buffer); },
+				[&]() { std::copy(input.begin(), input.end(), buffer.begin()); }
+			   );
+	}
+}
+
+static void bench_voices()
+{
+	unsigned long const rates[] = { 48000, 44100, 32000, 22050, 96000 };
+
+	for (bool widen : { false, true })
+	{
+		for (unsigned long rate : rates)
+		{
+			Sample sample = make_sample(rate, 2.0, widen);
+			Track  track(RATE, BLOCK, "Bench");
+			Voice  voice(&sample, &track, awe::Filter::xSinCos(0.8f, 0.25f));
+
+			awe::AfBuffer buffer(BLOCK * 2, 0.0f);
+			awe::ArenderConfig const config(RATE, BLOCK);
+
+			char params[64];
+			snprintf(params, sizeof(params), "%lu -> %zu Hz, %s", rate, RATE, widen ? "float32" : "int16");
+
+			measure("Voice::render", params, "frame", BLOCK,
+					[&]() { voice.render(buffer, config); },
+					[&]() {
+						std::fill(buffer.begin(), buffer.end(), 0.0f);
+						if (voice.is_active() == false)
+							voice.make_active(nullptr);
+					}
+				   );
+		}
+	}
+}
+
+static void bench_tracks()
+{
+	Sample sample = make_sample(44100, 4.0, false);
+
+	for (awe::Alayout layout : { awe::Alayout::INTERLEAVED, awe::Alayout::PLANAR })
+	{
+		for (size_t count : { 1, 8, 64, 512 })
+		{
+			Track track(RATE, BLOCK, "Bench", layout);
+
+			std::vector<Voice> voices;
+			voices.reserve(count);
+			for (size_t i = 0; i < count; i++) {
+				voices.emplace_back(&sample, &track, awe::Filter::xSinCos(0.5f, (i % 16) / 8.0f - 1.0f));
+				track.attach_source(&voices.back());
+			}
+
+			awe::AfBuffer buffer(BLOCK * 2, 0.0f);
+			awe::ArenderConfig const config(RATE, BLOCK);
+
+			char params[64];
+			snprintf(params, sizeof(params), "%zu sources, 44100 -> %zu Hz%s", count, RATE,
+					layout == awe::Alayout::PLANAR ? ", planar" : "");
+
+			measure("Track", params, "frame", BLOCK,
+					[&]() { track.render(buffer, config); },
+					[&]() {
+						std::fill(buffer.begin(), buffer.end(), 0.0f);
+						for (Voice &voice : voices)
+							if (voice.is_active() == false)
+								voice.make_active(nullptr);
+					}
+				   );
+		}
+	}
+}
+
+static void bench_models()
+{
+	static const ENoteKey keys[] = {
+		ENoteKey::P1_S, ENoteKey::P1_1, ENoteKey::P1_2, ENoteKey::P1_3,
+		ENoteKey::P1_4, ENoteKey::P1_5, ENoteKey::P1_6, ENoteKey::P1_7
+	};
+
+	// 200 measures of sixteenth notes with a tempo change every 8 measures.
+	Sequence sequence;
+	size_t   notes = 0;
+
+	for (unsigned int m = 0; m < 200; m++)
+	{
+		sequence.emplace_back(TSignature { 4, 48 });
+		Measure &bar = sequence.back();
+
+		if (m % 8 == 0)
+			bar.mCCs.emplace_back(TTime(0, 0, m), EControl::CLOCK_TEMPO, 120.0f + m % 64);
+
+		for (unsigned int i = 0; i < 16; i++) {
+			NoteAudio const audio { static_cast<unsigned short>(1 + i), 1, 1.0f, 0.0f };
+			bar.mNSs.emplace_back(keys[i % 8], TTime((i % 4) * 12, i / 4, m), audio);
+			notes++;
+		}
+	}
+	populateIndices(sequence);
+
+	size_t sink = 0;
+	measure("getNoteTimes", "200 measures", "note", notes,
+			[&]() { sink += getNoteTimes(sequence, 150.0).size(); },
+			[&]() { }
+		   );
+
+	if (sink == 0)
+		fprintf(stderr, "getNoteTimes returned no notes.\n");
+}
+
+/** Plays a number of voices through a device-less `AudioManager` and
+ *  times the blocks it renders.
+ *
+ *  Output is taken from the engine as soon as it is rendered, so blocks
+ *  are rendered back to back and the time of each is compared against the
+ *  block deadline.
+ */
+static StressLevel stress_level(AudioManager &am, std::vector<Sample> const &sources, size_t voices)
+{
+	SampleMap map;
+	for (size_t i = 0; i < voices; i++)
+		map[static_cast<unsigned int>(i + 1)] = sources[i % sources.size()];
+
+	am.wipe_SampleMap(false);
+	am.swap_SampleMap(map);
+
+	awe::Aprofiler &profiler = awe::Aprofiler::get();
+	awe::APortAudio &device  = am.getOutputDevice();
+
+	// Voices restart at staggered blocks, so the load stays even.
+	double const period = RATE / gStress.retrigger / BLOCK;
+	std::vector<double> next(voices);
+	for (size_t i = 0; i < voices; i++)
+		next[i] = period * i / voices;
+
+	size_t const warmup  = 8;
+	size_t       block   = 0;
+	double       playing = 0.0;
+	size_t       samples = 0;
+
+	while (block < warmup + gStress.blocks)
+	{
+		if (block == warmup)
+			profiler.reset();
+
+		NoteAudioList notes;
+		for (size_t i = 0; i < voices; i++)
+		{
+			if (next[i] > block)
+				continue;
+
+			notes.push_back(NoteAudio { static_cast<unsigned short>(i + 1), 1, 1.0f, 0.0f });
+			next[i] += period;
+		}
+		if (notes.empty() == false)
+			am.play(notes);
+
+		// Wait for the engine to render the next block, then take it.
+		for (bool taken = false; taken == false; )
+		{
+			size_t const frames = device.drain();
+			if (frames != 0) {
+				block += frames / BLOCK;
+				taken  = true;
+			}
+			std::this_thread::yield();
+		}
+
+		if (block > warmup) {
+			playing += am.count_Voices();
+			samples += 1;
+		}
+	}
+
+	StressLevel level;
+	level.voices    = voices;
+	level.playing   = samples == 0 ? 0.0 : playing / samples;
+	level.block     = profiler.summary(awe::Astage::BLOCK);
+	level.sustained = level.block.p99 <= profiler.getDeadline();
+
+	fprintf(stderr, "stress %5zu voices (%7.1f playing): p50 %8.1f us, p99 %8.1f us, max %8.1f us of %.0f us %s\n",
+			voices, level.playing,
+			level.block.p50 / 1000.0, level.block.p99 / 1000.0, level.block.max / 1000.0,
+			profiler.getDeadline() / 1000.0, level.sustained ? "ok" : "MISSED");
+
+	return level;
+}
+
+/** Finds the highest polyphony whose blocks render within the deadline,
+ *  doubling the voice count until a level fails and then bisecting.
+ */
+static void stress()
+{
+	if (gStress.enabled == false)
+		return;
+
+	AudioManager::gFloatSamples = gStress.widen;
+	awe::Aprofiler::get().setEnabled(true);
+
+	std::vector<Sample> sources;
+	for (unsigned long rate : gStress.rates)
+		sources.push_back(make_sample(rate, gStress.length, gStress.widen));
+
+	AudioManager am(BLOCK, RATE, awe::APortAudio::HostAPIType::Null);
+
+	auto run = [&](size_t voices) -> bool {
+		gStressLevels.push_back(stress_level(am, sources, voices));
+		return gStressLevels.back().sustained;
+	};
+
+	size_t pass = 0, fail = 0;
+	for (size_t voices = 1; voices <= gStress.limit; voices *= 2)
+	{
+		if (run(voices) == false) {
+			fail = voices;
+			break;
+		}
+		pass = voices;
+	}
+
+	while (fail != 0 && fail - pass > 1)
+	{
+		size_t const mid = (pass + fail) / 2;
+		if (run(mid))
+			pass = mid;
+		else
+			fail = mid;
+	}
+
+	am.wipe_SampleMap(false);
+	gStressMax = pass;
+
+	fprintf(stderr, "stress: %zu voices sustained at %zu frames per block.\n", gStressMax, BLOCK);
+}
+
+static void write_json(FILE* out)
+{
+	fprintf(out, "{\n");
+	fprintf(out, "    \"sample_rate\": %zu,\n", RATE);
+	fprintf(out, "    \"block_frames\": %zu,\n", BLOCK);
+	fprintf(out, "    \"results\": [");
+
+	for (size_t i = 0; i < gResults.size(); i++)
+	{
+		Result const &r = gResults[i];
+		double const ns = r.nanos / r.count;
+
+		fprintf(out, "%s\n        { \"name\": \"%s\", \"params\": \"%s\", \"%ss\": %llu, "
+				"\"ns_per_%s\": %.3f, \"%ss_per_second\": %.0f }",
+				i == 0 ? "" : ",",
+				r.name.c_str(), r.params.c_str(),
+				r.unit.c_str(), static_cast<unsigned long long>(r.count),
+				r.unit.c_str(), ns,
+				r.unit.c_str(), 1e9 / ns);
+	}
+
+	fprintf(out, "\n    ]");
+
+	if (gStress.enabled)
+	{
+		fprintf(out, ",\n    \"stress\": {\n");
+		fprintf(out, "        \"deadline_ns\": %llu,\n",
+				static_cast<unsigned long long>(awe::Aprofiler::get().getDeadline()));
+		fprintf(out, "        \"sample_precision\": \"%s\",\n", gStress.widen ? "float32" : "int16");
+		fprintf(out, "        \"max_voices\": %zu,\n", gStressMax);
+		fprintf(out, "        \"levels\": [");
+
+		for (size_t i = 0; i < gStressLevels.size(); i++)
+		{
+			StressLevel const &l = gStressLevels[i];
+			fprintf(out, "%s\n            { \"voices\": %zu, \"playing\": %.1f, "
+					"\"p50_ns\": %.0f, \"p99_ns\": %.0f, \"max_ns\": %.0f, \"sustained\": %s }",
+					i == 0 ? "" : ",",
+					l.voices, l.playing, l.block.p50, l.block.p99, l.block.max,
+					l.sustained ? "true" : "false");
+		}
+
+		fprintf(out, "\n        ]\n    }");
+	}
+
+	fprintf(out, "\n}\n");
+}
+
+int main(int argc, char** argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+			gMinTime = atof(argv[++i]);
+		} else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+			gFilter = argv[++i];
+		} else if (strcmp(argv[i], "--stress") == 0) {
+			gStress.enabled = true;
+		} else if (strcmp(argv[i], "--stress-only") == 0) {
+			gStress.enabled = true;
+			gBenchmarks     = false;
+		} else if (strcmp(argv[i], "--length") == 0 && i + 1 < argc) {
+			gStress.length = std::max(0.1, atof(argv[++i]));
+		} else if (strcmp(argv[i], "--rates") == 0 && i + 1 < argc) {
+			gStress.rates.clear();
+			for (char* rate = strtok(argv[++i], ","); rate != nullptr; rate = strtok(nullptr, ","))
+				if (strtoul(rate, nullptr, 10) != 0)
+					gStress.rates.push_back(strtoul(rate, nullptr, 10));
+			if (gStress.rates.empty())
+				gStress.rates.push_back(RATE);
+		} else if (strcmp(argv[i], "--retrigger") == 0 && i + 1 < argc) {
+			gStress.retrigger = std::max(0.01, atof(argv[++i]));
+		} else if (strcmp(argv[i], "--blocks") == 0 && i + 1 < argc) {
+			gStress.blocks = std::max(1, atoi(argv[++i]));
+		} else if (strcmp(argv[i], "--max-voices") == 0 && i + 1 < argc) {
+			gStress.limit = std::min(65535, std::max(1, atoi(argv[++i])));
+		} else if (strcmp(argv[i], "--float") == 0) {
+			gStress.widen = true;
+		} else {
+			fprintf(stderr,
+					"usage: %s [--min-time seconds] [--filter name]\n"
+					"       [--stress | --stress-only] [--length seconds] [--rates hz,...]\n"
+					"       [--retrigger hz] [--blocks count] [--max-voices count] [--float]\n",
+					argv[0]);
+			return 1;
+		}
+	}
+
+	if (gBenchmarks) {
+		bench_filters();
+		bench_voices();
+		bench_tracks();
+		bench_models();
+	}
+	stress();
+
+	write_json(stdout);
+	return 0;
+}
@@ -3,8 +3,11 @@
 #include <algorithm>
 #include "Chart_BMS.hpp"
 #include "Models/NoteAlgorithm.hpp"
+#include "libawe/Log.hpp"
 #include <ClanLib/core.h>
 #include "Music.hpp"
+#include "SampleCache.hpp"
+#include "SampleCompactor.hpp"
 
 
 uint string_to_raw_uint(const std::string &str)
@@ -281,7 +284,7 @@ void Chart_BMS::load_chart()
                 {
                     TTime time = wrap(m.signature, i*factor); time.m = mn;
                     m.mCCs.emplace_back(time, EControl::CLOCK_TEMPO, (float)bpm);
-                    printf("BMS [info] Added BPM_D event at %u:%u:%u [%u]\n",
+                    AWE_LOG(DEBUG, "BMS", "Added BPM_D event at %u:%u:%u [%u]",
                             time.m, time.b, time.t, bpm
                             );
                 }
@@ -305,8 +308,8 @@ void Chart_BMS::load_chart()
                 } else {
                     TTime time = wrap(m.signature, i*factor); time.m = mn;
                     m.mCCs.emplace_back(time, EControl::CLOCK_TEMPO, (float)bpms[bpm]);
-                    printf("BMS [info] Added BPM_L event at %u:%u:%u [%s]->%lf\n",
-                            time.m, time.b, time.t, str.c_str(), bpms[bpm]
+                    AWE_LOG(DEBUG, "BMS", "Added BPM_L event at %u:%u:%u [%u]->%lf",
+                            time.m, time.b, time.t, bpm, bpms[bpm]
                             );
                 }
             }
@@ -326,8 +329,8 @@ void Chart_BMS::load_chart()
                 } else {
                     TTime time = wrap(m.signature, i*factor); time.m = mn;
                     m.mCCs.emplace_back(time, EControl::CLOCK_STOP_T, (int32_t)stops[stop]);
-                    printf("BMS [info] Added STOP event at %u:%u:%u [%s]->%u\n",
-                            time.m, time.b, time.t, str.c_str(), stops[stop]
+                    AWE_LOG(DEBUG, "BMS", "Added STOP event at %u:%u:%u [%u]->%u",
+                            time.m, time.b, time.t, stop, stops[stop]
                             );
                 }
             }
@@ -458,19 +461,68 @@ void Chart_BMS::load_chart()
 
 }
 
-void Chart_BMS::load_samples()
+Chart::SampleJobs Chart_BMS::prepare_samples()
 {
+    SampleJobs jobs;
+    mSampleSources.clear();
+
     for(auto def : wavs)
     {
         std::string file = bms_fullpath;
         file = clan::PathHelp::add_trailing_slash(file);
         file.append(def.second);
-        Sample sample( file.c_str() );
-        if (sample.cgetSource() == nullptr)
-            printf("[warn] Failed to load sample: %s\n", file.c_str());
-        else
+
+        // WAV files are cached by file, so they all share sample ID 0.
+        SampleCache::Source source;
+        bool const cacheable = SampleCache::identify(file, source);
+
+        Sample sample;
+        if (cacheable && SampleCache::get().fetch(source, 0, sample)) {
             mSampleMap->operator [](def.first) = sample;
+            continue;
+        }
+
+        // Decoded samples are cached in `finish_samples`.
+        if (cacheable)
+            mSampleSources[def.first] = source;
+
+        jobs.push_back(SampleJob { def.first, cacheable ? static_cast<size_t>(source.size) : 0,
+            [file] (Sample& sample) -> bool
+            {
+                sample = Sample( file, AudioManager::gStreamThreshold );
+                if (sample.hasData() == false) {
+                    printf("[warn] Failed to load sample: %s\n", file.c_str());
+                    return false;
+                }
+
+                return true;
+            }
+        });
     }
+
+    return jobs;
+}
+
+void Chart_BMS::finish_samples(bool compacted)
+{
+    if (compacted == false)
+        SampleCompactor::compact(*mSampleMap).print(bms_fullpath);
+
+    for(auto const &def : mSampleSources)
+    {
+        auto it = mSampleMap->find(def.first);
+        if (it != mSampleMap->end())
+            SampleCache::get().store(def.second, 0, it->second);
+    }
+
+    mSampleSources.clear();
+}
+
+void Chart_BMS::load_samples()
+{
+    SampleJobs jobs = prepare_samples();
+    run_sample_jobs(jobs);
+    finish_samples();
 }
 
 Music* scan_BMS_directory(const std::string &path)
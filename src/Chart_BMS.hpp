@@ -5,6 +5,7 @@
 #define CHART_BMS_H
 
 #include "Models/Chart.hpp"
+#include "SampleCache.hpp"
 
 struct Music;
 class Chart_BMS : public Chart
@@ -47,6 +48,8 @@ protected:
 
     unsigned int    measures;
 
+    std::map<uint, SampleCache::Source> mSampleSources; //!< Files of samples being decoded.
+
 public:
     Chart_BMS(const std::string &path);
 
@@ -57,6 +60,9 @@ public:
     virtual void load_cover_art();
     virtual void load_chart    ();
     virtual void load_samples  ();
+
+    virtual SampleJobs prepare_samples() override;
+    virtual void       finish_samples (bool compacted = false) override;
 };
 
 Music* scan_BMS_directory(const std::string &path);
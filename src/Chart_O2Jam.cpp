@@ -1,4 +1,9 @@
+#include <cstring>
 #include "Chart_O2Jam.hpp"
+#include "MappedFile.hpp"
+#include "SampleCache.hpp"
+#include "SampleCompactor.hpp"
+#include "SampleDiskCache.hpp"
 #include "Music.hpp"
 #include "Models/NoteInstanceAlgorithm.hpp" // zip
 
@@ -55,7 +60,11 @@ Music* openOJN (const std::string& path)
 O2JamChart::O2JamChart(const std::string &path, const OJN_Header &header, uint8_t index) :
 	ojn_path   (path),
 	ojn_header (header),
-	chart_index(index)
+	chart_index(index),
+	mSamplesSource   (),
+	mSamplesCacheable(false),
+	mSamplesLoaded   (false),
+	mSamplesDecoded  (false)
 {
 	if (index > 2)
 		throw std::invalid_argument("Invalid chart index.");
@@ -80,23 +89,16 @@ void O2JamChart::load_cover_art()
 	if (ojn_header.newCoverArtSize == 0)
 		return;
 
-	clan::File file;
-	if (file.open(ojn_path,
-				clan::File::OpenMode::open_existing,
-				clan::File::AccessFlags::access_read
-				) == false)
+	MappedFile::Pointer file = MappedFile::open(ojn_path);
+	if (file == nullptr)
 		return;
 
-	file.seek(ojn_header.DataOffset[3], clan::File::seek_set);
+	uint8_t const* buffer = file->at(ojn_header.DataOffset[3], ojn_header.newCoverArtSize);
 
-	uint8_t* buffer = new uint8_t[ojn_header.newCoverArtSize];
-
-	int read = file.read(buffer, ojn_header.newCoverArtSize);
-
-	if (read == static_cast<int>(ojn_header.newCoverArtSize)) {
+	if (buffer != nullptr) {
 		try
 		{
-			clan::DataBuffer        dbuff ( buffer, read );
+			clan::DataBuffer        dbuff ( buffer, ojn_header.newCoverArtSize );
 			clan::IODevice_Memory   memio ( dbuff );
 
 			mCover = clan::PixelBuffer{ memio, "jpg", false };
@@ -105,8 +107,6 @@ void O2JamChart::load_cover_art()
 			clan::Console::write_line(e.get_message_and_stack_trace());
 		}
 	}
-
-	delete[] buffer;
 }
 
 void O2JamChart::load_chart ()
@@ -122,35 +122,106 @@ void O2JamChart::load_chart ()
 	size_t cP = 0, cN = 0, cSN = 0, cLN = 0, cHN = 0, cRN = 0, cPN = 0, cAN = 0;
 
 
+	mSequence->reserve(mSequence->size() + ojn_header.numMeasures[chart_index] + 1);
 	for (unsigned n = 0; n <= ojn_header.numMeasures[chart_index]; n++)
 		mSequence->emplace_back(TSignature{ 4, 48 });
 
-	clan::File file;
-
-	if( file.open(ojn_path, clan::File::open_existing, clan::File::access_read) == false )
+	MappedFile::Pointer file = MappedFile::open(ojn_path);
+	if (file == nullptr)
 		return;
 
-	int chartSize = file.get_size() - ojn_header.DataOffset[chart_index];
+	// Chart data ends where the next chart (or the cover art) begins.
+	uint32_t const chartBegin = ojn_header.DataOffset[chart_index];
+	uint32_t       chartEnd   = ojn_header.DataOffset[chart_index + 1];
 
-	file.seek(ojn_header.DataOffset[chart_index], clan::File::seek_set);
-
-	uint8_t* buffer = new uint8_t[chartSize];
-	int read = file.read(buffer, chartSize);
-	if (read != chartSize)
+	if (chartBegin > file->size())
 		throw std::runtime_error("Malformed OJN file.");
 
-	const uint8_t* pPtr = buffer;
+	if (chartEnd <= chartBegin || chartEnd > file->size())
+		chartEnd = file->size();
+
+	size_t const chartSize = chartEnd - chartBegin;
+
+	const uint8_t* const pBegin = file->at(chartBegin, chartSize);
+	const uint8_t* const pEnd   = pBegin + chartSize;
+	file->advise(chartBegin, chartSize, MappedFile::Advice::SEQUENTIAL);
 
-	// OJN Note Set parse loop
-	for (unsigned j = 0; j < ojn_header.numNoteSets[chart_index]; j++)
+	// Note set validation loop
+	//
+	// Checks every note set header against the chart range and counts the
+	// events going into each measure, so that the parse loop below never
+	// reads out of range and fills measures without reallocating them.
+	std::vector<size_t> nCCs(mSequence->size(), 0);
+	std::vector<size_t> nNSs(mSequence->size(), 0);
+	size_t nHNs = 0, nRNs = 0;
+
+	unsigned numNoteSets = 0;
+	for (const uint8_t* p = pBegin; numNoteSets < ojn_header.numNoteSets[chart_index]; numNoteSets++)
 	{
-		OJN_NoteSet_Header* pNoteSet = (OJN_NoteSet_Header*)pPtr;
+		if (static_cast<size_t>(pEnd - p) < sizeof(OJN_NoteSet_Header)) {
+			fprintf(stderr, "[warn] OJN chart ends after %u of %u note sets.\n", numNoteSets, ojn_header.numNoteSets[chart_index]);
+			break;
+		}
+
+		OJN_NoteSet_Header const* pNoteSet = (OJN_NoteSet_Header const*)p;
+		p += sizeof(OJN_NoteSet_Header);
+
+		if (pNoteSet->numEvents > static_cast<size_t>(pEnd - p) / 4) {
+			fprintf(stderr, "[warn] OJN note set %u has more events than the chart has bytes left.\n", numNoteSets);
+			break;
+		}
+
+		if (pNoteSet->Measure < mSequence->size()) {
+			for (uint16_t k = 0; k < pNoteSet->numEvents; k++) {
+				const uint8_t* e = p + 4 * k;
+				/****/ if (pNoteSet->Channel == 0) {
+					// Time signature; not stored as an event.
+				} else if (pNoteSet->Channel == 1) {
+					if (*((float const*)e) != 0.0f)
+						nCCs[pNoteSet->Measure]++;
+				} else if (((OJN_Note const*)e)->SampleID != 0) {
+					uint8_t Type = ((OJN_Note const*)e)->NoteType % 4;
+					/****/ if (pNoteSet->Channel >= 9 || Type < 2)
+						nNSs[pNoteSet->Measure]++;
+					else if (Type == 2)
+						nHNs++;
+					else
+						nRNs++;
+				}
+			}
+		}
+
+		p += 4 * pNoteSet->numEvents;
+	}
+
+	for (size_t m = 0; m < mSequence->size(); m++)
+	{
+		Measure& measure = mSequence->at(m);
+		measure.mCCs.reserve(measure.mCCs.size() + nCCs[m]);
+		measure.mNSs.reserve(measure.mNSs.size() + nNSs[m]);
+	}
+
+	HNL.reserve(nHNs);
+	RNL.reserve(nRNs);
+
+	const uint8_t* pPtr = pBegin;
+
+	// OJN Note Set parse loop; runs over validated note sets only.
+	for (unsigned j = 0; j < numNoteSets; j++)
+	{
+		OJN_NoteSet_Header const* pNoteSet = (OJN_NoteSet_Header const*)pPtr;
 		pPtr += sizeof(OJN_NoteSet_Header);
 
 		uint32_t iMeasure  = pNoteSet->Measure;
 		uint16_t iChannel  = pNoteSet->Channel;
 		uint16_t numEvents = pNoteSet->numEvents;
 
+		if (iMeasure >= mSequence->size()) {
+			fprintf(stderr, "[warn] Skipping OJN note set on out-of-range measure %u.\n", iMeasure);
+			pPtr += (4 * numEvents);
+			continue;
+		}
+
 		Measure& pMeasure = mSequence->at(iMeasure);
 
 		ENoteKey nChannel = ENoteKey::AUTO;
@@ -159,7 +230,8 @@ void O2JamChart::load_chart ()
 		{
 			// Time Signature changes
 			case 0:
-				pMeasure.setSignature(getTimeSignature(*((float*)pPtr)));
+				if (numEvents >= 1)
+					pMeasure.setSignature(getTimeSignature(*((float const*)pPtr)));
 
 				pPtr += (4 * numEvents);
 				break;
@@ -167,12 +239,12 @@ void O2JamChart::load_chart ()
 			case 1:
 				for (unsigned k = 0; k < numEvents; k++)
 				{
-					if (*((float*)pPtr) != 0.0f)
+					if (*((float const*)pPtr) != 0.0f)
 					{
 						uint16_t Tick = k * 192 / numEvents;
 						time = TTime(Tick % 48, Tick / 48, iMeasure);
 
-						pMeasure.mCCs.emplace_back(time, EControl::CLOCK_TEMPO, *((float*)pPtr));
+						pMeasure.mCCs.emplace_back(time, EControl::CLOCK_TEMPO, *((float const*)pPtr));
 						cP++;
 					}
 
@@ -199,7 +271,7 @@ void O2JamChart::load_chart ()
 					time = TTime(Tick % 48, Tick / 48, iMeasure);
 
 					// read note event
-					OJN_Note *pEvent = (OJN_Note*)pPtr;
+					OJN_Note const *pEvent = (OJN_Note const*)pPtr;
 					pPtr += 4;
 
 					uint16_t SmplID = pEvent->SampleID;
@@ -289,14 +361,11 @@ void O2JamChart::load_chart ()
 
 	// TODO: Note count
 	// this->notes = cPN;
-
-	delete[] buffer;
-
 }
 
 // O2Jam's M30 XORing
 // XOR sets of 4 bytes with mask. Remainder bytes are ignored.
-static void decrypt_M30XOR (uint8_t *&sData, unsigned int sSize, const uint8_t *sMask)
+static void decrypt_M30XOR (uint8_t *sData, unsigned int sSize, const uint8_t *sMask)
 {
 	for ( unsigned int i = 0; i + 3 < sSize; i += 4 )
 	{
@@ -367,30 +436,25 @@ static void decrypt_arrange (std::vector<uint8_t> &sData)
 	}
 }
 
-// type M30 parser
-void parseM30 (clan::File& file, SampleMap& sample_map)
+// type M30 parser; lists a decoding job for each sample
+void parseM30 (MappedFile::Pointer const& pFile, Chart::SampleJobs& jobs)
 {
-	const int fileSize = file.get_size();
-	static const /* constexpr */ int headSize = sizeof(M30_File_Header);   // 32 - 4 (signature) = 28
-	static const /* constexpr */ int M30hSize = sizeof(M30_Sample_Header); // 52 bytes
-
-	file.seek(0);
-
-	// create read buffer
-	uint8_t* buffer = new uint8_t[headSize];
-	int read = file.read(buffer, headSize);
-	if (read != headSize)
-		throw std::runtime_error("Malformed OJM file.");
+	MappedFile const& file = *pFile;
+	const size_t fileSize = file.size();
+	static const /* constexpr */ size_t M30hSize = sizeof(M30_Sample_Header); // 52 bytes
 
 	// read header
-	M30_File_Header *pFileHeader = (M30_File_Header*)buffer;
+	M30_File_Header const *pFileHeader = file.as<M30_File_Header>(0);
+	if (pFileHeader == nullptr)
+		throw std::runtime_error("Malformed OJM file.");
 
 	uint32_t smplEncryption = pFileHeader->encryption;
 	uint32_t smplCount      = pFileHeader->samples;
 	uint32_t smplOffset     = pFileHeader->payload_addr;
 	uint32_t packSize       = pFileHeader->payload_size;
 
-	delete[] buffer;
+	if (smplOffset > fileSize)
+		throw std::runtime_error("Malformed OJM file.");
 
 	if (packSize > fileSize - smplOffset) {
 		fprintf(stderr, "[debug] Header reports different payload size.\n");
@@ -398,85 +462,91 @@ void parseM30 (clan::File& file, SampleMap& sample_map)
 	}
 
 	// Jump to payload location
-	file.seek(smplOffset);
+	size_t offset = smplOffset;
 
 	for (unsigned int i = 0; i < smplCount; i++)
 	{
 		// Read M30 sample header
-		buffer = new uint8_t[M30hSize];
-		read = file.read(buffer, M30hSize);
-		if (read != M30hSize) {
+		M30_Sample_Header const *pSmplHeader = file.as<M30_Sample_Header>(offset);
+		if (pSmplHeader == nullptr) {
 			fprintf(stderr, "[debug] Fatal OJM file read error.\n");
-			delete[] buffer;
 			break;
 		}
+		offset += M30hSize;
 
-		M30_Sample_Header *pSmplHeader = (M30_Sample_Header*)buffer;
-
-		std::string smplName = pSmplHeader->name;
+		std::string smplName(pSmplHeader->name, strnlen(pSmplHeader->name, sizeof(pSmplHeader->name)));
 		smplName.append(".ogg");
 
 		uint32_t smplSize = pSmplHeader->size;
 		uint16_t smplType = pSmplHeader->type;
 		uint16_t smplID   = pSmplHeader->id+1;
 
-		delete[] buffer;
-
-		buffer = new uint8_t[smplSize];
-		read = file.read(buffer, smplSize);
-		if (read != (int)smplSize)
-			delete[] buffer;
-
-		uint8_t* pSmplData = buffer;
-
-		// decode sample
-		switch (smplEncryption) {
-			// unencrypted OGG
-			case  0: break;
-			         // namiXOR-ed OGG
-			case 16: decrypt_M30XOR(pSmplData, smplSize, M30_nami_XORMASK); break;
-			         // 0412XOR-ed OGG
-			case 32: decrypt_M30XOR(pSmplData, smplSize, M30_0412_XORMASK); break;
+		uint8_t const* pSmplData = file.at(offset, smplSize);
+		if (pSmplData == nullptr) {
+			fprintf(stderr, "[debug] Fatal OJM file read error.\n");
+			break;
 		}
+		offset += smplSize;
 
 		// type M### note
 		if (smplType == 0)
 			smplID += 1000;
 
+		// The job holds on to the mapping until it has been run.
+		jobs.push_back(Chart::SampleJob { smplID, smplSize,
+			[pFile, pSmplData, smplSize, smplName, smplEncryption] (Sample& sample) -> bool
+			{
+				// Decrypted sample data
+				std::vector<uint8_t> smplData;
+				uint8_t const* pData = pSmplData;
+
+				// decode sample
+				switch (smplEncryption) {
+					// unencrypted OGG; read straight from the mapping
+					case  0: break;
+					         // namiXOR-ed OGG
+					case 16:
+						smplData.assign(pSmplData, pSmplData + smplSize);
+						decrypt_M30XOR(smplData.data(), smplSize, M30_nami_XORMASK);
+						pData = smplData.data();
+						break;
+					         // 0412XOR-ed OGG
+					case 32:
+						smplData.assign(pSmplData, pSmplData + smplSize);
+						decrypt_M30XOR(smplData.data(), smplSize, M30_0412_XORMASK);
+						pData = smplData.data();
+						break;
+				}
 
-		// pass into OGG stream
-		Sample pSample((char*)pSmplData, smplSize, smplName.c_str());
+				// pass into OGG stream
+				sample = Sample((char const*)pData, smplSize, smplName.c_str(), AudioManager::gStreamThreshold);
 
-		if (pSample.getSource() == nullptr)
-			fprintf(stderr, "[warn] Failed to load M30 sample: %s\n", smplName.c_str());
-		else
-			sample_map[smplID] = pSample;
+				if (sample.hasData() == false) {
+					fprintf(stderr, "[warn] Failed to load M30 sample: %s\n", smplName.c_str());
+					return false;
+				}
 
-		delete[] buffer;
+				return true;
+			}
+		});
 	}
 
 }
 
 
-// type OMC parser
-void parseOMC (clan::File& file, bool isEncrypted, SampleMap& sample_map)
+// type OMC parser; lists a decoding job for each sample
+void parseOMC (MappedFile::Pointer const& pFile, bool isEncrypted, Chart::SampleJobs& jobs)
 {
+	MappedFile const& file = *pFile;
 	// read headers
-	int fileSize = file.get_size();
-	static const /* constexpr */ int headSize = sizeof(OMC_File_Header);
+	const size_t fileSize = file.size();
 	static const /* constexpr */ int WAVhSize = sizeof(OMC_WAV_Header);
 	static const /* constexpr */ int OGGhSize = sizeof(OMC_OGG_Header);
 
-	file.seek(0);
-
-	// create read buffer
-	uint8_t* buffer = new uint8_t[headSize];
-	int read = file.read(buffer, headSize);
-	if (read != headSize)
-		throw std::runtime_error("Malformed OJM file.");
-
 	// read header
-	OMC_File_Header *pFileHeader = (OMC_File_Header*)buffer;
+	OMC_File_Header const *pFileHeader = file.as<OMC_File_Header>(0);
+	if (pFileHeader == nullptr)
+		throw std::runtime_error("Malformed OJM file.");
 
 	// Sample ID counter
 	uint16_t smplID;
@@ -499,33 +569,24 @@ void parseOMC (clan::File& file, bool isEncrypted, SampleMap& sample_map)
 		OGG_PackSize = fileSize - OGG_Offset;
 	}
 
-	// clear buffer
-	delete[] buffer;
+	if (WAV_Offset > fileSize || OGG_Offset > fileSize)
+		throw std::runtime_error("Malformed OJM file.");
 
 
 	if (WAV_PackSize > 0)
 	{
 		// parse WAV files
-		// create new read buffer from offset
-		file.seek(WAV_Offset);
-
-		buffer = new uint8_t[WAV_PackSize];
-		read = file.read(buffer, WAV_PackSize);
-		if (read != (int)WAV_PackSize) {
-			fprintf(stderr, "[fatal] Fatal OJM file read error.\n");
-			delete[] buffer;
-		}
-
-		uint8_t* pPtr = buffer;
+		uint8_t const* pPtr = file.at(WAV_Offset, WAV_PackSize);
+		file.advise(WAV_Offset, WAV_PackSize, MappedFile::Advice::SEQUENTIAL);
 
 		smplID = 0; // WAV
 
 		unsigned long i = 0;
 
-		while (i < WAV_PackSize)
+		while (i + WAVhSize <= WAV_PackSize)
 		{
 			// read WAV header
-			OMC_WAV_Header *pWAVHeader = (OMC_WAV_Header*)pPtr;
+			OMC_WAV_Header const *pWAVHeader = (OMC_WAV_Header const*)pPtr;
 			pPtr += WAVhSize, i += WAVhSize;
 			smplID++;
 
@@ -587,8 +648,9 @@ void parseOMC (clan::File& file, bool isEncrypted, SampleMap& sample_map)
 				decrypt_accXOR (pSmplData);
 			}
 
-			// create WAVE file buffer
-			std::vector<uint8_t> poSmplData;
+			// create WAVE file buffer; decryption above depends on the
+			// samples before this one, so it cannot be left to the job.
+			auto poSmplData = std::make_shared< std::vector<uint8_t> >();
 
 			WAV_Header WAVOutHead =
 			{ .RIFF_ID   = 0x46464952           // "RIFF"
@@ -606,22 +668,26 @@ void parseOMC (clan::File& file, bool isEncrypted, SampleMap& sample_map)
 					, .data_ChunkSize = SampleSize
 			};
 			uint8_t* pWAVOutHead = reinterpret_cast<uint8_t*>(&WAVOutHead);
-			poSmplData.insert(poSmplData.end(), pWAVOutHead, pWAVOutHead + sizeof(WAVOutHead));
-			poSmplData.insert(poSmplData.end(), pSmplData.begin(), pSmplData.begin() + SampleSize);
+			poSmplData->insert(poSmplData->end(), pWAVOutHead, pWAVOutHead + sizeof(WAVOutHead));
+			poSmplData->insert(poSmplData->end(), pSmplData.begin(), pSmplData.begin() + SampleSize);
 
-			// pass into WAVE stream
-			Sample pSample((char*)poSmplData.data(), poSmplData.size(), SampleName.c_str());
+			jobs.push_back(Chart::SampleJob { smplID, poSmplData->size(),
+				[poSmplData, SampleName] (Sample& sample) -> bool
+				{
+					// pass into WAVE stream
+					sample = Sample((char const*)poSmplData->data(), poSmplData->size(), SampleName.c_str());
 
-			if (pSample.getSource() == nullptr)
-				fprintf(stderr, "[warn] Failed to load OMC WAV sample: %s\n", SampleName.c_str());
-			else
-				sample_map[smplID] = pSample;
+					if (sample.hasData() == false) {
+						fprintf(stderr, "[warn] Failed to load OMC WAV sample: %s\n", SampleName.c_str());
+						return false;
+					}
+
+					return true;
+				}
+			});
 
 			pPtr += SampleSize, i += SampleSize;
 		}
-
-		delete[] buffer;
-
 	}
 
 	/* reset accXOR */
@@ -632,23 +698,16 @@ void parseOMC (clan::File& file, bool isEncrypted, SampleMap& sample_map)
 
 	if (OGG_PackSize > 0)
 	{
-		// parse OGG/MP3 files
-		// create new read buffer from offset
-		file.seek(OGG_Offset);
-
-		buffer = new uint8_t[OGG_PackSize];
-		read = file.read(buffer, OGG_PackSize);
-		if (read != (int)OGG_PackSize)
-			delete[] buffer;
-
-		uint8_t* pPtr = buffer;
+		// parse OGG/MP3 files; samples are decoded straight from the mapping
+		uint8_t const* pPtr = file.at(OGG_Offset, OGG_PackSize);
+		file.advise(OGG_Offset, OGG_PackSize, MappedFile::Advice::SEQUENTIAL);
 
 		smplID = 1000;
 
-		for(unsigned long i = 0; i < OGG_PackSize; )
+		for(unsigned long i = 0; i + OGGhSize <= OGG_PackSize; )
 		{
 			// read header
-			OMC_OGG_Header *pOGGHeader = (OMC_OGG_Header*)pPtr;
+			OMC_OGG_Header const *pOGGHeader = (OMC_OGG_Header const*)pPtr;
 			pPtr += OGGhSize, i += OGGhSize;
 
 			smplID++;
@@ -656,48 +715,105 @@ void parseOMC (clan::File& file, bool isEncrypted, SampleMap& sample_map)
 			std::string SampleName = pOGGHeader->name; // already has extension
 			uint32_t    SampleSize = pOGGHeader->size;
 
+			if (SampleSize > OGG_PackSize - i) {
+				fprintf(stderr, "[error] Skipping OGG section (Bad OGG file size descriptor)\n");
+				break;
+			}
+
 			if (SampleSize != 0) {
-				uint8_t* pSmplData = pPtr;
+				uint8_t const* pSmplData = pPtr;
 				pPtr += SampleSize, i += SampleSize;
 
-				Sample pSample((char*)pSmplData, SampleSize, SampleName.c_str());
+				// The job holds on to the mapping until it has been run.
+				jobs.push_back(Chart::SampleJob { smplID, SampleSize,
+					[pFile, pSmplData, SampleSize, SampleName] (Sample& sample) -> bool
+					{
+						sample = Sample((char const*)pSmplData, SampleSize, SampleName.c_str(), AudioManager::gStreamThreshold);
 
-				if (pSample.getSource() == nullptr)
-					fprintf(stderr, "[warn] Failed to load OMC M sample: %s\n", SampleName.c_str());
-				else
-					sample_map[smplID] = pSample;
+						if (sample.hasData() == false) {
+							fprintf(stderr, "[warn] Failed to load OMC M sample: %s\n", SampleName.c_str());
+							return false;
+						}
 
+						return true;
+					}
+				});
 			}
 
 		}
 	}
 }
 
-void O2JamChart::load_samples()
+Chart::SampleJobs O2JamChart::prepare_samples()
 {
-	clan::File file;
-	if (file.open(ojm_path,
-				clan::File::OpenMode::open_existing,
-				clan::File::AccessFlags::access_read
-				) == false)
+	mSamplesLoaded  = false;
+	mSamplesDecoded = false;
+
+	// Charts sharing this OJM, and retries of this chart, decode it only once.
+	mSamplesCacheable = SampleCache::identify(ojm_path, mSamplesSource);
+	if (mSamplesCacheable && SampleCache::get().fetch(mSamplesSource, *mSampleMap))
+		return SampleJobs();
+
+	// Loaded samples are cached in `finish_samples`, after the caller had a
+	// chance to move them elsewhere.
+	if (SampleDiskCache::get().load(ojm_path, *mSampleMap)) {
+		mSamplesLoaded = true;
+		return SampleJobs();
+	}
+
+	MappedFile::Pointer file = MappedFile::open(ojm_path);
+	if (file == nullptr)
 		throw std::invalid_argument("Failed to open OJM file.");
 
-	if (file.get_size() < 4)
+	uint32_t const* signature = file->as<uint32_t>(0);
+	if (signature == nullptr)
 		throw std::invalid_argument("Malformed OJM file.");
 
+	SampleJobs jobs;
+
 	// Read file based on signature
-	uint32_t signature = file.read_uint32();
-	switch (signature)
+	switch (*signature)
 	{
-		case OJM_SIGNATURE: parseOMC(file, false, *mSampleMap); break;
-		case OMC_SIGNATURE: parseOMC(file, true , *mSampleMap); break;
-		case M30_SIGNATURE: parseM30(file, *mSampleMap); break;
+		case OJM_SIGNATURE: parseOMC(file, false, jobs); break;
+		case OMC_SIGNATURE: parseOMC(file, true , jobs); break;
+		case M30_SIGNATURE: parseM30(file, jobs); break;
 		default: fprintf(stderr, "[warn] Unknown OJM signature. \n");
 	}
 
+	// Samples are decoded out of order from here on.
+	file->advise(MappedFile::Advice::RANDOM);
+
+	mSamplesLoaded  = true;
+	mSamplesDecoded = true;
+	return jobs;
+}
+
+void O2JamChart::finish_samples(bool compacted)
+{
+	if (mSamplesLoaded == false)
+		return;
+
+	if (compacted == false)
+		SampleCompactor::compact(*mSampleMap).print(ojm_path);
+
+	if (mSamplesCacheable)
+		SampleCache::get().store(mSamplesSource, *mSampleMap);
+
+	if (mSamplesDecoded)
+		SampleDiskCache::get().save(ojm_path, *mSampleMap);
+
+	mSamplesLoaded  = false;
+	mSamplesDecoded = false;
+}
+
+void O2JamChart::load_samples()
+{
+	SampleJobs jobs = prepare_samples();
+	run_sample_jobs(jobs);
+	jobs.clear(); // Releases the mapping.
+	finish_samples();
 }
 
 
 
 };
-
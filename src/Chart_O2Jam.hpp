@@ -6,6 +6,7 @@
 
 #include "Models/Chart.hpp"
 #include "Chart_O2Jam.hh"
+#include "SampleCache.hpp"
 
 struct Music;
 
@@ -20,12 +21,20 @@ protected:
     OJN_Header  ojn_header;
     uint8_t     chart_index;
 
+    SampleCache::Source mSamplesSource;     //!< Identity of the OJM being loaded.
+    bool                mSamplesCacheable;  //!< OJM identity is known.
+    bool                mSamplesLoaded;     //!< Samples are being loaded from the OJM or its disk cache.
+    bool                mSamplesDecoded;    //!< Samples are being decoded from the OJM.
+
 public:
     O2JamChart(const std::string &path, const OJN_Header &header, uint8_t index);
 
     virtual void load_cover_art () override;
     virtual void load_chart     () override;
     virtual void load_samples   () override;
+
+    virtual SampleJobs prepare_samples() override;
+    virtual void       finish_samples (bool compacted = false) override;
 };
 
 Music* openOJN(const std::string &path);
@@ -1,5 +1,14 @@
 #include "Game.hpp"
+#include "AudioForensics.hpp"
+#include "AudioSpeed.hpp"
 #include "Main.hpp"
+#include "RealTime.hpp"
+#include "SampleCache.hpp"
+#include "SampleCompactor.hpp"
+#include "SampleDiskCache.hpp"
+#include "SampleLoader.hpp"
+#include "StemRenderer.hpp"
+#include "libawe/Profile.hpp"
 
 JSONFile Game::conf("conf.json");
 JSONFile Game::skin("skin.json");
@@ -61,6 +70,127 @@ std::shared_ptr<Game> Game::create()
 			&JSONReader::getBoolean, "debug", false
 			);
 
+	SampleCache::get().setBudget(conf.get_if_else_set(
+			&JSONReader::getInteger, "audio.sample-cache.budget", 256,
+			[] (const int &value) -> bool { return value >= 0; }
+			) * (size_t(1) << 20));
+
+	SampleCompactor::gTrimSilence = conf.get_or_set(
+			&JSONReader::getBoolean, "audio.sample-compaction.trim-silence", true
+			);
+	SampleCompactor::gMergeDuplicates = conf.get_or_set(
+			&JSONReader::getBoolean, "audio.sample-compaction.merge-duplicates", true
+			);
+
+	AudioManager::gStreamThreshold = conf.get_if_else_set(
+			&JSONReader::getDecimal, "audio.streaming.threshold", 0.0,
+			[] (const double &value) -> bool { return value >= 0.0; }
+			);
+	AudioManager::gStreamAhead = conf.get_if_else_set(
+			&JSONReader::getDecimal, "audio.streaming.ahead", 0.5,
+			[] (const double &value) -> bool { return value > 0.0; }
+			);
+
+	AudioManager::gMatchSampleRate = conf.get_or_set(
+			&JSONReader::getBoolean, "audio.match-sample-rate", false
+			);
+
+	AudioManager::gFloatSamples = conf.get_if_else_set(
+			&JSONReader::getString, "audio.sample-precision", std::string("int16"),
+			[] (const std::string &value) -> bool { return value == "int16" || value == "float32"; }
+			) == "float32";
+#if !AWE_FLOAT_SAMPLES
+	if (AudioManager::gFloatSamples) {
+		fprintf(stderr, "[warn] float32 sample precision is not compiled in; using int16.\n");
+		AudioManager::gFloatSamples = false;
+	}
+#endif
+
+	AudioManager::gPlanar = conf.get_if_else_set(
+			&JSONReader::getString, "audio.channel-layout", std::string("interleaved"),
+			[] (const std::string &value) -> bool { return value == "interleaved" || value == "planar"; }
+			) == "planar";
+
+	AudioManager::gPrepareAhead = conf.get_if_else_set(
+			&JSONReader::getDecimal, "audio.prepare-ahead", 0.0,
+			[] (const double &value) -> bool { return value >= 0.0; }
+			);
+
+	AudioManager::gProfilePeriod = conf.get_if_else_set(
+			&JSONReader::getDecimal, "audio.profile-period", 0.0,
+			[] (const double &value) -> bool { return value >= 0.0; }
+			);
+	awe::Aprofiler::get().setEnabled(AudioManager::gProfilePeriod > 0.0);
+
+	AudioManager::gQueueMin = conf.get_if_else_set(
+			&JSONReader::getInteger, "audio.queue.min-blocks", 2,
+			[] (const int &value) -> bool { return value >= 1; }
+			);
+	AudioManager::gQueueMax = conf.get_if_else_set(
+			&JSONReader::getInteger, "audio.queue.max-blocks", 8,
+			[] (const int &value) -> bool { return value >= 1; }
+			);
+	AudioManager::gQueueShrinkAfter = conf.get_if_else_set(
+			&JSONReader::getDecimal, "audio.queue.shrink-after", 10.0,
+			[] (const double &value) -> bool { return value > 0.0; }
+			);
+
+	AudioManager::gSpeed = conf.get_if_else_set(
+			&JSONReader::getDecimal, "audio.speed", 1.0,
+			[] (const double &value) -> bool { return value >= AudioSpeed::MIN_SPEED && value <= AudioSpeed::MAX_SPEED; }
+			);
+
+	AudioForensics::gHistory = conf.get_if_else_set(
+			&JSONReader::getDecimal, "audio.forensics.history", 0.0,
+			[] (const double &value) -> bool { return value >= 0.0; }
+			);
+	AudioForensics::gPath = conf.get_or_set(
+			&JSONReader::getString, "audio.forensics.path", std::string("forensics")
+			);
+
+	if (RealTime::parse(conf.get_or_set(&JSONReader::getString, "audio.realtime.policy", std::string("normal")), RealTime::gPolicy) == false)
+		fprintf(stderr, "[warn] Unknown audio.realtime.policy; expected normal, fifo or rr.\n");
+	RealTime::gPriority = conf.get_if_else_set(
+			&JSONReader::getInteger, "audio.realtime.priority", 70,
+			[] (const int &value) -> bool { return value >= 1 && value <= 99; }
+			);
+	if (RealTime::parse(conf.get_or_set(&JSONReader::getString, "audio.realtime.cores", std::string("")), RealTime::gCores) == false)
+		fprintf(stderr, "[warn] audio.realtime.cores is not a comma-separated list of cores.\n");
+	if (RealTime::parse(conf.get_or_set(&JSONReader::getString, "audio.realtime.lock-memory", std::string("none")), RealTime::gLocking) == false)
+		fprintf(stderr, "[warn] Unknown audio.realtime.lock-memory; expected none, samples or all.\n");
+	RealTime::gPrefault = conf.get_or_set(
+			&JSONReader::getBoolean, "audio.realtime.prefault", false
+			);
+	RealTime::lock_process();
+
+	StemRenderer::gEnabled = conf.get_or_set(
+			&JSONReader::getBoolean, "audio.background-stem", false
+			);
+
+	SampleLoader::gLeadTime = conf.get_if_else_set(
+			&JSONReader::getDecimal, "audio.progressive.lead", 2.0,
+			[] (const double &value) -> bool { return value >= 0.0; }
+			);
+	SampleLoader::gMargin = conf.get_if_else_set(
+			&JSONReader::getDecimal, "audio.progressive.margin", 1.5,
+			[] (const double &value) -> bool { return value >= 1.0; }
+			);
+
+	SampleLoader::gArenaSlab = conf.get_if_else_set(
+			&JSONReader::getInteger, "audio.arena.slab-size", 4,
+			[] (const int &value) -> bool { return value >= 0; }
+			) * (size_t(1) << 20);
+	SampleLoader::gHugePages = conf.get_or_set(
+			&JSONReader::getBoolean, "audio.arena.huge-pages", false
+			);
+
+	SampleDiskCache::get().configure(
+			conf.get_or_set(&JSONReader::getBoolean, "audio.disk-cache.enabled", false),
+			conf.get_or_set(&JSONReader::getString , "audio.disk-cache.path"   , std::string("cache")),
+			// Samples keep their own rate when the output follows them.
+			AudioManager::gMatchSampleRate ? 0 : conf.getInteger("audio.sample-rate")
+			);
+
 	////    Initialize display
 	const sizei displayResolution = conf.get_if_else_set(
 			&JSONReader::getVec2i, "video.resolution", vec2i{ 640, 480 },
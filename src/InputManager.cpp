@@ -64,5 +64,7 @@ InputManager::InputManager(clan::InputContext clIC)
     try_lock(clan::keycode_down);
     try_lock(clan::keycode_left);
     try_lock(clan::keycode_right);
+    try_lock(clan::keycode_f3);
+    try_lock(clan::keycode_f4);
 }
 
@@ -6,10 +6,14 @@
 #include <ClanLib/gl.h>
 #endif
 
+#include <cmath>
+
 #include "Main.hpp"
 #include "Game.hpp"
 
 #include "MusicScanner.hpp"
+#include "SampleLoader.hpp"
+#include "StemRenderer.hpp"
 #include "Models/Tracker.hpp"
 
 #include "Scenes/MusicSelector.hpp"
@@ -38,6 +42,7 @@ int App::main(const std::vector<std::string> & args)
 		MusicList   ML = scan_music_dir("./Music");
 		auto        MS = std::make_shared<UI::MusicSelector>(ML);
 		std::shared_ptr<Tracker> CT;
+		std::shared_ptr<SampleLoader> SL;
 
 		gGame->add_subview(MS);
 		MS->set_focus();
@@ -50,21 +55,39 @@ int App::main(const std::vector<std::string> & args)
 				if (CT) {
 					if (CT->hasChartEnded())
 					{
+						gGame->am.report_Samples();
 						MS->set_hidden(false);
 						gGame->show();
 						CT = nullptr;
+						SL = nullptr;
 					} else {
 						gGame->hide();
+
+						// F3 and F4 step the playback speed down and up.
+						if (gGame->im.try_lock(clan::keycode_f3))
+							stepSpeed(*CT, -1);
+						if (gGame->im.try_lock(clan::keycode_f4))
+							stepSpeed(*CT, +1);
+
 						CT->update();
 						gGame->am.play(CT->getNAs());
 						CT->getNAs().clear();
+
+						if (AudioManager::gPrepareAhead > 0.0) {
+							Tracker::NAs hints;
+							CT->getUpcomingNAs(hints, AudioManager::gPrepareAhead);
+							gGame->am.prepare(hints);
+						}
 					}
 				} else {
 					// Initiate chart
 					auto chart = MS->get();
-					launchChart(chart);
+					SL = launchChart(chart);
 					CT = std::make_shared<Tracker>(chart, JHard, Tracker::KeyBindings{}, nullptr);
+					CT->setStemmed(gGame->am.play_Stem());
+					CT->getClock()->setSpeed(gGame->am.getSpeed());
 					CT->getClock()->start();
+					CT->getClock()->holdBack(gGame->am.getSpeedDelay() * 1000.0);
 					clan::Console::write_line("Tracker clock started.");
 				}
 			}
@@ -79,10 +102,58 @@ int App::main(const std::vector<std::string> & args)
 	return 0;
 }
 
-void App::launchChart(std::shared_ptr<Chart> chart)
+std::shared_ptr<SampleLoader> App::launchChart(std::shared_ptr<Chart> chart)
 {
+	auto const begin = std::chrono::steady_clock::now();
+
 	chart->load_chart();
-	chart->load_samples();
 	gGame->am.wipe_SampleMap( );
-	gGame->am.swap_SampleMap(*chart->getSampleMap());
+
+	auto loader = std::make_shared<SampleLoader>(chart, gGame->am);
+
+	// Keep the window responsive while the first samples are decoded.
+	while (loader->ready() == false && gGame->keep_alive)
+		clan::KeepAlive::process(10);
+
+	// The stem needs every sample it plays to be decoded, and the output
+	// rate is matched against all of them.
+	if (StemRenderer::gEnabled || AudioManager::gMatchSampleRate)
+		while (loader->done() == false && gGame->keep_alive)
+			clan::KeepAlive::process(10);
+
+	if (AudioManager::gMatchSampleRate)
+		gGame->am.match_SampleRate();
+
+	if (StemRenderer::gEnabled) {
+		SampleMap samples = gGame->am.copy_SampleMap();
+		gGame->am.set_Stem(StemRenderer::render(
+					*chart, samples, gGame->am.getMasterTrack().getConfig().sampleRate
+					));
+	}
+
+	fprintf(stderr, "[info] Chart ready after %lld ms.\n",
+			static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+					std::chrono::steady_clock::now() - begin
+					).count())
+		   );
+
+	return loader;
+}
+
+void App::stepSpeed(Tracker &tracker, int steps)
+{
+	static const double STEP = 0.05;
+	static const double RAMP = 0.2;
+
+	// Round to whole steps, so that stepping back lands on normal speed.
+	double const speed = std::round(gGame->am.getSpeed() / STEP + steps) * STEP;
+
+	// A speed stage set up just now starts at its speed, without a ramp,
+	// and delays the audio from then on; the clock follows both.
+	double const delay = gGame->am.getSpeedDelay();
+	double const ramp  = delay > 0.0 ? RAMP : 0.0;
+
+	gGame->am.set_Speed(speed, ramp);
+	tracker.getClock()->setSpeed(gGame->am.getSpeed(), ramp * 1000.0);
+	tracker.getClock()->holdBack((gGame->am.getSpeedDelay() - delay) * 1000.0);
 }
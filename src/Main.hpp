@@ -9,6 +9,8 @@
 
 class Game;
 class Chart;
+class SampleLoader;
+class Tracker;
 
 class App
 {
@@ -20,7 +22,16 @@ public:
 
 	static int main(std::vector<std::string> const &args);
 
-	static void launchChart(std::shared_ptr<Chart> chart);
+	/** Loads a chart and its samples, returning as soon as playback can
+	 *  start while the rest of the samples keep loading in the background.
+	 */
+	static std::shared_ptr<SampleLoader> launchChart(std::shared_ptr<Chart> chart);
+
+	/** Steps the playback speed of the audio and of a tracker's clock
+	 *  by 5% steps, ramping both together and keeping the clock in time
+	 *  with the speed stage.
+	 */
+	static void stepSpeed(Tracker &tracker, int steps);
 };
 
 #endif
@@ -0,0 +1,165 @@
+//  MappedFile.cpp :: Shared read-only memory-mapped file
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#include "MappedFile.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <sys/stat.h>
+
+#if !( defined(_WIN32) || defined(_WIN64) )
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define MAPPED_FILE_USE_MMAP
+#endif
+
+//  Registry of live mappings, keyed by path.
+static std::mutex                                           gRegistryMutex;
+static std::map< std::string, std::weak_ptr<MappedFile const> > gRegistry;
+
+bool MappedFile::Identity::operator== (Identity const &other) const
+{
+	return inode == other.inode && size == other.size && mtime == other.mtime;
+}
+
+bool MappedFile::identify(std::string const &path, Identity &identity)
+{
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0)
+		return false;
+
+	identity = Identity { static_cast<uint64_t>(st.st_ino), st.st_size, st.st_mtime };
+	return true;
+}
+
+MappedFile::MappedFile(std::string const &path)
+	: mPath(path)
+	, mData(nullptr)
+	, mSize(0)
+	, mHeap(false)
+	, mIdentity { 0, 0, 0 }
+{
+#ifdef MAPPED_FILE_USE_MMAP
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+		::close(fd);
+		return;
+	}
+
+	mIdentity = Identity { static_cast<uint64_t>(st.st_ino), st.st_size, st.st_mtime };
+
+	void* ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd); // The mapping holds its own reference to the file.
+
+	if (ptr == MAP_FAILED) {
+		fprintf(stderr, "MappedFile [error] Could not map %s.\n", path.c_str());
+		return;
+	}
+
+	mData = static_cast<uint8_t const *>(ptr);
+	mSize = st.st_size;
+#else
+	FILE* file = fopen(path.c_str(), "rb");
+	if (file == nullptr)
+		return;
+
+	identify(path, mIdentity);
+
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	if (size > 0) {
+		uint8_t* buffer = new uint8_t[size];
+		if (fread(buffer, 1, size, file) == static_cast<size_t>(size)) {
+			mData = buffer;
+			mSize = size;
+			mHeap = true;
+		} else {
+			delete[] buffer;
+		}
+	}
+
+	fclose(file);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+	if (mData == nullptr)
+		return;
+
+	if (mHeap) {
+		delete[] mData;
+	} else {
+#ifdef MAPPED_FILE_USE_MMAP
+		munmap(const_cast<uint8_t*>(mData), mSize);
+#endif
+	}
+}
+
+MappedFile::Pointer MappedFile::open(std::string const &path)
+{
+	std::lock_guard<std::mutex> lock(gRegistryMutex);
+
+	//  A file replaced since it was mapped gets a mapping of its own.
+	Identity current;
+	Pointer file = gRegistry[path].lock();
+	if (file && identify(path, current) && file->mIdentity == current)
+		return file;
+
+	file = Pointer(new MappedFile(path));
+	if (file->data() == nullptr) {
+		gRegistry.erase(path);
+		return nullptr;
+	}
+
+	//  Drop registry entries of mappings that have since been released.
+	for(auto it = gRegistry.begin(); it != gRegistry.end(); ) {
+		if (it->second.expired())
+			it = gRegistry.erase(it);
+		else
+			it++;
+	}
+
+	gRegistry[path] = file;
+	return file;
+}
+
+void MappedFile::advise(size_t offset, size_t length, Advice advice) const
+{
+#ifdef MAPPED_FILE_USE_MMAP
+	if (mHeap || offset >= mSize)
+		return;
+
+	length = std::min(length, mSize - offset);
+
+	//  madvise requires a page-aligned address.
+	static const size_t page = sysconf(_SC_PAGESIZE);
+	size_t const skew = offset % page;
+	offset -= skew;
+	length += skew;
+
+	int flag = MADV_NORMAL;
+	switch (advice) {
+		case Advice::NORMAL    : flag = MADV_NORMAL    ; break;
+		case Advice::SEQUENTIAL: flag = MADV_SEQUENTIAL; break;
+		case Advice::RANDOM    : flag = MADV_RANDOM    ; break;
+		case Advice::WILLNEED  : flag = MADV_WILLNEED  ; break;
+		case Advice::DONTNEED  : flag = MADV_DONTNEED  ; break;
+	}
+
+	madvise(const_cast<uint8_t*>(mData) + offset, length, flag);
+#else
+	(void) offset;
+	(void) length;
+	(void) advice;
+#endif
+}
@@ -0,0 +1,107 @@
+//  MappedFile.hpp :: Shared read-only memory-mapped file
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/**
+ * Read-only view of a whole file mapped into memory.
+ *
+ * Mappings are shared: opening a path that is already mapped by another
+ * owner returns the same object, so the three charts inside an OJN file
+ * and every reload of an OJM are served from the page cache without any
+ * copying. The mapping is released when the last owner lets go of it.
+ * A file replaced on disk, e.g. by renaming another file over it, gets a
+ * new mapping; owners of the old one keep seeing the old contents.
+ *
+ * On platforms without `mmap` the file is read into a heap buffer instead,
+ * which keeps the interface usable at the cost of the zero-copy property.
+ */
+class MappedFile
+{
+public:
+	//! Access pattern hints passed on to `madvise`.
+	enum class Advice : uint8_t {
+		NORMAL,     //!< No special treatment.
+		SEQUENTIAL, //!< Range will be read once from start to end.
+		RANDOM,     //!< Range will be read in no particular order.
+		WILLNEED,   //!< Range will be read soon; start reading ahead.
+		DONTNEED    //!< Range will not be read again for a while.
+	};
+
+	using Pointer = std::shared_ptr<MappedFile const>;
+
+private:
+	std::string     mPath;  //!< Path the file was opened with.
+	uint8_t const * mData;  //!< Beginning of mapped data.
+	size_t          mSize;  //!< Size of mapped data in bytes.
+	bool            mHeap;  //!< Data was read into the heap instead of mapped.
+
+	//! Identity of the file that was mapped.
+	struct Identity
+	{
+		uint64_t inode;
+		int64_t  size;
+		int64_t  mtime;
+
+		bool operator== (Identity const &other) const;
+	};
+
+	Identity        mIdentity;
+
+	/** Identifies the file at a path.
+	 *  \return false if the file could not be inspected.
+	 */
+	static bool identify(std::string const &path, Identity &identity);
+
+	MappedFile(std::string const &path);
+
+public:
+	~MappedFile();
+
+	MappedFile(MappedFile const &) = delete;
+	MappedFile& operator=(MappedFile const &) = delete;
+
+	/** Opens and maps a file or retrieves the existing mapping of it.
+	 *  \return nullptr if the file could not be opened or is empty.
+	 */
+	static Pointer open(std::string const &path);
+
+	inline std::string const & getPath() const { return mPath; }
+	inline uint8_t     const * data   () const { return mData; }
+	inline size_t              size   () const { return mSize; }
+
+	/** Retrieves a pointer to a range inside the file.
+	 *  \return nullptr if the range does not lie entirely inside the file.
+	 */
+	inline uint8_t const * at(size_t offset, size_t length) const
+	{
+		if (offset > mSize || length > mSize - offset)
+			return nullptr;
+		return mData + offset;
+	}
+
+	/** Retrieves a pointer to a structure inside the file.
+	 *  \return nullptr if the structure does not fit inside the file.
+	 */
+	template< class T >
+	inline T const * as(size_t offset) const
+	{
+		return reinterpret_cast<T const *>(at(offset, sizeof(T)));
+	}
+
+	/** Tells the kernel how a range of the file is going to be read.
+	 *  Ranges outside the file are clipped; this call does nothing on
+	 *  platforms without `madvise`.
+	 */
+	void advise(size_t offset, size_t length, Advice advice) const;
+
+	inline void advise(Advice advice) const { advise(0, mSize, advice); }
+};
+
+#endif
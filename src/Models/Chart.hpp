@@ -4,6 +4,8 @@
 #ifndef MODEL_CHART_H
 #define MODEL_CHART_H
 
+#include <functional>
+#include <vector>
 #include <ClanLib/display.h>
 #include "../__zzCore.hpp"
 #include "../AudioManager.hpp"
@@ -12,6 +14,17 @@
 
 class Chart
 {
+public:
+	//! Decoding work for a single sample.
+	struct SampleJob
+	{
+		unsigned int                    id;     //!< Sample ID to decode.
+		size_t                          weight; //!< Decoding cost; usually the size of encoded data.
+		std::function<bool(Sample&)>    decode; //!< Decodes the sample. Returns false on failure.
+	};
+
+	using SampleJobs = std::vector<SampleJob>;
+
 protected:
 	ChartInfo mInfo;      //!< Information about this chart.
 
@@ -32,7 +45,32 @@ public:
 	virtual void load_chart    () = 0;
 	virtual void load_samples  () = 0;
 
+	/** Prepares the sample map for loading in parts.
+	 *
+	 *  Samples available without decoding are put into the sample map right
+	 *  away; the rest are returned as jobs which may be run in any order,
+	 *  one at a time, before `finish_samples` is called. The default
+	 *  implementation loads everything through `load_samples`.
+	 */
+	virtual SampleJobs prepare_samples() { load_samples(); return SampleJobs(); }
+
+	/** Called once every job from `prepare_samples` has been run.
+	 *  \param compacted true if decoded samples went through a
+	 *                   `SampleCompactor` one by one as they came in.
+	 */
+	virtual void finish_samples(bool /*compacted*/ = false) { }
+
 	void load_all     ();
+	//! Runs sample jobs in order, putting decoded samples into the sample map.
+	inline void run_sample_jobs(SampleJobs &jobs)
+	{
+		for(SampleJob & job : jobs) {
+			Sample sample;
+			if (job.decode(sample))
+				(*mSampleMap)[job.id] = sample;
+		}
+	}
+
 	inline void sort_sequence() { for(Measure & measure : *mSequence) { measure.sort_elements(); } }
 
 	inline ChartInfo const & cgetInfo() const { return mInfo; }
@@ -32,6 +32,35 @@ void TClock::resetClock (double BPM, bool startNow)
     tpt_Music = tpt_LastRun = tpt_Segment = sysClock::now();
 }
 
+// Change playback speed, moving to it linearly over ramp_ms milliseconds.
+void TClock::setSpeed (double speed, double ramp_ms)
+{
+    // Ramp from wherever the current ramp has got to.
+    tmp_speed0  = (tmp_ramp > 0.0)
+                ? tmp_speed + (tmp_speed0 - tmp_speed) * tmp_ramp / tmp_rampLen
+                : tmp_speed;
+    tmp_speed   = speed;
+    tmp_ramp    = tmp_rampLen = (ramp_ms > 0.0) ? ramp_ms : 0.0;
+}
+
+// Converts elapsed milliseconds to music milliseconds at the playback speed.
+double TClock::scale (double ms)
+{
+    double music = 0.0;
+
+    if (tmp_ramp > 0.0) {
+        double const part = (ms < tmp_ramp) ? ms : tmp_ramp;
+
+        // Average speed over this part of the ramp.
+        double const mid = 1.0 - (tmp_ramp - part / 2.0) / tmp_rampLen;
+        music    += part * (tmp_speed0 + (tmp_speed - tmp_speed0) * mid);
+        tmp_ramp -= part;
+        ms       -= part;
+    }
+
+    return music + ms * tmp_speed;
+}
+
 // Update clock. Returns false if interrupted.
 bool TClock::update()
 {
@@ -41,7 +70,7 @@ bool TClock::update()
         // This casting and converting hack is done to make the clock run correctly on Linux.
         // The original works just fine on Windows.
         //       -= std::chrono::duration_cast<TimeUnit>(tpt_now - tpt_LastRun).count();
-        tct_mstt -= std::chrono::duration_cast<std::chrono::microseconds>(tpt_now - tpt_LastRun).count() / 1000.0;
+        tct_mstt -= scale(std::chrono::duration_cast<std::chrono::microseconds>(tpt_now - tpt_LastRun).count() / 1000.0);
         tpt_LastRun = tpt_now;
     }
 
@@ -27,6 +27,11 @@ private:
     double      tmp_bpm;        // Tempo in beats per minute
     double      tmp_mspt;       // Tempo in milliseconds per tick
 
+    double      tmp_speed;      // Playback speed factor
+    double      tmp_speed0;     // Playback speed factor at the start of the ramp
+    double      tmp_ramp;       // Milliseconds left of the speed ramp
+    double      tmp_rampLen;    // Length of the speed ramp in milliseconds
+
     double      tct_mstt;       // Milliseconds left to next tick
     unsigned    tct_tick;       // Total tick count
 
@@ -36,8 +41,12 @@ private:
 
     TTime       currTTime;      // Current TTime
     TTime       nextTTime;      // Next TTime interrupt
+
+    // Converts elapsed milliseconds to music milliseconds at the playback speed.
+    double scale (double ms);
 public:
     TClock (double BPM = 0.0, bool startNow = false)
+        : tmp_speed(1.0), tmp_speed0(1.0), tmp_ramp(0.0), tmp_rampLen(0.0)
     {
         tpt_Create = tpt_Music = tpt_LastRun = tpt_Segment = sysClock::now();
         this->resetClock(BPM, startNow);
@@ -77,6 +86,17 @@ public:
         tct_mstt += tmp_mspt;
     }
 
+    // Change playback speed, moving to it linearly over ramp_ms milliseconds.
+    // Use the same speed and ramp as the audio manager to stay in time with it.
+    void setSpeed (double speed, double ramp_ms = 0.0);
+
+    // Hold the clock back by ms milliseconds of music, e.g. while audio
+    // mixed ahead of it is still on its way out. Negative values skip ahead.
+    inline void holdBack (double ms)
+    {
+        tct_mstt += ms;
+    }
+
     inline void setTStop (unsigned t)
     {
         tct_stop = t;
@@ -110,6 +130,7 @@ public:
 
     inline double getTempo_bpm  () { return tmp_bpm ; }
     inline double getTempo_mspt () { return tmp_mspt; }
+    inline double getSpeed      () const { return tmp_speed; }
 };
 
 
@@ -44,6 +44,9 @@ public:
 	inline const JudgeScore   & getScore() const { return mScore; }
 	inline       bool           isScored() const { return mScore.rank != EJudgeRank::NONE; }
 
+	//! Audio played when this note is next hit.
+	virtual const NoteAudio& getNextAudio() const = 0;
+
 	// Initialize note tick position based on sequence (through tracker).
 	virtual void init  (const Tracker &tracker) = 0;
 
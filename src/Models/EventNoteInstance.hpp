@@ -17,6 +17,7 @@ public:
 	virtual ~EventNoteSingle() { }
 
 	const NoteAudio& getAudio() const { return mAudio; }
+	virtual const NoteAudio& getNextAudio() const override { return getAudio(); }
 
 	virtual void init  (const Tracker&) override;
 	virtual void render(const Tracker&, clan::Canvas&) const override;
@@ -42,6 +43,7 @@ public:
 	virtual ~EventNoteLong() { }
 
 	const NoteAudio& getAudio() const { return mEscore.rank == EJudgeRank::NONE ? mBaudio : mEaudio; }
+	virtual const NoteAudio& getNextAudio() const override { return getAudio(); }
 
 	virtual void init  (const Tracker&) override;
 	virtual void render(const Tracker&, clan::Canvas&) const override;
@@ -2,6 +2,7 @@
 //  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
 
 #include <cassert>
+#include <tuple>
 #include "Sequence.hpp"
 #include "NoteAlgorithm.hpp"
 
@@ -92,3 +93,64 @@ long int getTDistance(const Sequence &sequence, TTime a, TTime b)
 	return r;
 }
 
+
+std::vector<TimedNote> getNoteTimes(const Sequence &sequence, double tempo, bool with_stops)
+{
+	std::vector<TimedNote> notes;
+
+	// Milliseconds per tick at 1 BPM; see `TClock::resetClock`.
+	static const double TEMPO_MSPT = 60000.0 / 48.0;
+
+	double bpm = tempo > 0.0 ? tempo : 120.0;
+	double ms  = 0.0;
+
+	for(const Measure &m : sequence)
+	{
+		// Events in this measure as (tick, order, index). Tempo changes go
+		// before notes on the same tick and stops go after them.
+		std::vector< std::tuple<tick_delta_t, int, size_t> > events;
+
+		for(size_t i = 0; i < m.mCCs.size(); i++)
+		{
+			const EventCC &cc = m.mCCs[i];
+			tick_delta_t const tick = cc.t.b * m.getB() + cc.t.t;
+
+			if (-cc.c == EControl::CLOCK_TEMPO && cc.v.asFloat > 0.0f)
+				events.emplace_back(tick, 0, i);
+			else if (-cc.c == EControl::CLOCK_STOP_T && with_stops && cc.v.asInteger > 0)
+				events.emplace_back(tick, 2, i);
+		}
+
+		for(size_t i = 0; i < m.mNSs.size(); i++)
+			events.emplace_back(m.mNSs[i].t.b * m.getB() + m.mNSs[i].t.t, 1, i);
+
+		for(size_t i = 0; i < m.mNLs.size(); i++)
+			events.emplace_back(m.mNLs[i].t.b * m.getB() + m.mNLs[i].t.t, 1, m.mNSs.size() + i);
+
+		std::sort(events.begin(), events.end());
+
+		tick_delta_t tick = 0;
+		for(auto const &event : events)
+		{
+			ms  += (std::get<0>(event) - tick) * TEMPO_MSPT / bpm;
+			tick = std::get<0>(event);
+
+			size_t const i = std::get<2>(event);
+			switch(std::get<1>(event))
+			{
+				case 0: bpm = m.mCCs[i].v.asFloat; break;
+				case 2: ms += m.mCCs[i].v.asInteger * TEMPO_MSPT / bpm; break;
+				default:
+					if (i < m.mNSs.size())
+						notes.push_back(TimedNote { &m.mNSs[i], m.mNSs[i].getAudio(), ms });
+					else
+						notes.push_back(TimedNote { &m.mNLs[i - m.mNSs.size()], m.mNLs[i - m.mNSs.size()].getAudio(), ms });
+					break;
+			}
+		}
+
+		ms += (m.tick_count - std::min<tick_delta_t>(tick, m.tick_count)) * TEMPO_MSPT / bpm;
+	}
+
+	return notes;
+}
@@ -26,4 +26,17 @@ long int getTDistance(const Sequence &, TTime, TTime);
 //! milliseconds.
 double   getRDistance(const Sequence &, TTime, TTime);
 
+//! Note event along with the audio it plays and when it is reached.
+struct TimedNote
+{
+	const EventNote *   note;
+	NoteAudio           audio;
+	double              ms;     //!< Milliseconds from the start of the sequence.
+};
+
+//! Lists every note in a sequence in time order, timed the way `TClock`
+//! counts time from an initial tempo. Tick-based stops are applied unless
+//! `with_stops` is false.
+std::vector<TimedNote> getNoteTimes(const Sequence &, double tempo, bool with_stops = true);
+
 #endif
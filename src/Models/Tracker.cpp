@@ -6,6 +6,7 @@
 #include "EventNoteInstance.hpp"
 #include "NoteKey.hpp"
 #include "NoteAlgorithm.hpp"
+#include "../libawe/Log.hpp"
 
 Tracker::Tracker
 	( ChartPtr      chart
@@ -27,6 +28,7 @@ Tracker::Tracker
 	, mChartEnded       (false)
 	, mMeasureIterStart (0)
 	, mAutoplay         (false)
+	, mStemmed          (false)
 	, mSpeedX           (1.0f)
 {
 	mJudge.calculateTiming(mClock->getTempo_mspt());
@@ -105,7 +107,7 @@ Tracker::NAs            & Tracker:: getNAs     ()       { return mNAs; }
 
 void Tracker::update()
 {
-	fprintf(stderr, "Tracker::update() [%u:%u:%u].\n", mTime.m, mTime.b, mTime.t);
+	AWE_LOG(DEBUG, "Tracker", "update() [%u:%u:%u].", mTime.m, mTime.b, mTime.t);
 
 	mClock->update();
 
@@ -130,19 +132,19 @@ void Tracker::updateCCs()
 		switch(mNextCC->c)
 		{
 			case EControl::CLOCK_TEMPO:
-				fprintf(stderr, "CC CLOCK_TEMPO.\n");
+				AWE_LOG(DEBUG, "Tracker", "CC CLOCK_TEMPO.");
 				mClock->setTempo(mNextCC->v.asFloat);
 				mJudge.calculateTiming(mClock->getTempo_mspt());
 				break;
 			case EControl::CLOCK_STOP_T:
-				fprintf(stderr, "CC CLOCK_STOP_T.\n");
+				AWE_LOG(DEBUG, "Tracker", "CC CLOCK_STOP_T.");
 				mClock->setTStop(mNextCC->v.asInteger);
 				break;
 			default:
 				if (isOff(mNextCC->c))
-					fprintf(stderr, "[warn] CC not handled: Unknown / unimplemented control type '%u'.\n", mNextCC->c);
+					AWE_LOG(WARN, "Tracker", "CC not handled: Unknown / unimplemented control type '%u'.", mNextCC->c);
 				else
-					fprintf(stderr, "[warn] CC not handled: Control set as dead '-%u/%u'.\n",- mNextCC->c, mNextCC->c);
+					AWE_LOG(WARN, "Tracker", "CC not handled: Control set as dead '-%u/%u'.", - mNextCC->c, mNextCC->c);
 				break;
 		}
 
@@ -157,7 +159,7 @@ void Tracker::updateCCs()
 	   ) {
 		mClock->setITime(mNextCC->t);
 	} else if (mNextCC->t < mTime) {
-		fprintf(stderr, "[warn] CC not handled on time.\n");
+		AWE_LOG(WARN, "Tracker", "CC not handled on time.");
 	}
 }
 
@@ -180,7 +182,7 @@ void Tracker::updateNEs()
 			{
 				NoteAudio aNote = makeEmpty();
 				note->update(mJudge, mCurrentTick, InputKeyStatus::AUTO, aNote);
-				if (isEmpty(aNote) == false)
+				if (isEmpty(aNote) == false && (mStemmed == false || ENoteKey_isAutoPlay(channel.key) == false))
 					mNAs.push_back(aNote);
 
 				// TODO Show note hit effect
@@ -193,3 +195,27 @@ void Tracker::updateNEs()
 		}
 	}
 }
+
+void Tracker::getUpcomingNAs(NAs &hints, double window) const
+{
+	if (mChartEnded)
+		return;
+
+	double const ticks = window * mClock->getSpeed() / mClock->getTempo_mspt();
+
+	for(Channel const &channel : mChannels)
+	{
+		// Notes played by a stem have no voices of their own.
+		if (mStemmed && ENoteKey_isAutoPlay(channel.key))
+			continue;
+
+		for(auto it = channel.next_note; it != channel.notes.end(); it++)
+		{
+			if ((*it)->getTick() - mCurrentTick > ticks)
+				break;
+
+			if (isEmpty((*it)->getNextAudio()) == false)
+				hints.push_back((*it)->getNextAudio());
+		}
+	}
+}
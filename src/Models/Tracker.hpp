@@ -71,6 +71,7 @@ private:
 
 	////    Physical Modifiers    /////////////////////////////////////
 	bool            mAutoplay;
+	bool            mStemmed;   //!< Autoplay and BG notes are played by a pre-rendered stem.
 	float           mSpeedX;
 
 public:
@@ -88,9 +89,21 @@ public:
 
 	inline bool hasChartEnded() const { return mChartEnded; }
 
+	//! Stops sending audio of autoplay and BG notes, which a stem plays instead.
+	inline void setStemmed(bool stemmed) { mStemmed = stemmed; }
+
 	void update();
 	void updateCCs();
 	void updateNEs();
+
+	/** Lists the audio of notes coming up within a time window, for the
+	 *  audio manager to prepare voices for. Tempo changes and stops
+	 *  within the window are not accounted for.
+	 *
+	 *  \param hints   List to append note audio to.
+	 *  \param window  Window length in milliseconds of wall-clock time.
+	 */
+	void getUpcomingNAs(NAs &hints, double window) const;
 };
 
 #endif
@@ -0,0 +1,185 @@
+//  RealTime.cpp :: Real-time scheduling and memory locking for audio threads
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#include "RealTime.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#if !( defined(_WIN32) || defined(_WIN64) )
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define REAL_TIME_POSIX
+#endif
+
+RealTime::Policy    RealTime::gPolicy   = RealTime::Policy::NORMAL;
+int                 RealTime::gPriority = 70;
+std::vector<int>    RealTime::gCores    = {};
+RealTime::Locking   RealTime::gLocking  = RealTime::Locking::NONE;
+bool                RealTime::gPrefault = false;
+
+//  Only the first failure of each kind is reported.
+static std::atomic_flag gWarnedPolicy   = ATOMIC_FLAG_INIT;
+static std::atomic_flag gWarnedAffinity = ATOMIC_FLAG_INIT;
+static std::atomic_flag gWarnedLock     = ATOMIC_FLAG_INIT;
+
+bool RealTime::parse(std::string const &name, Policy &policy)
+{
+	/****/ if (name == "normal") { policy = Policy::NORMAL;
+	} else if (name == "fifo"  ) { policy = Policy::FIFO;
+	} else if (name == "rr"    ) { policy = Policy::RR;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+bool RealTime::parse(std::string const &name, Locking &locking)
+{
+	/****/ if (name == "none"   ) { locking = Locking::NONE;
+	} else if (name == "samples") { locking = Locking::SAMPLES;
+	} else if (name == "all"    ) { locking = Locking::ALL;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+bool RealTime::parse(std::string const &list, std::vector<int> &cores)
+{
+	std::vector<int>    parsed;
+	std::stringstream   stream(list);
+	std::string         item;
+
+	while (std::getline(stream, item, ','))
+	{
+		char* end = nullptr;
+		long  core = std::strtol(item.c_str(), &end, 10);
+		if (end == item.c_str() || core < 0)
+			return false;
+
+		parsed.push_back(static_cast<int>(core));
+	}
+
+	cores.swap(parsed);
+	return true;
+}
+
+void RealTime::apply(char const *name, bool worker)
+{
+#ifdef REAL_TIME_POSIX
+	if (gPolicy != Policy::NORMAL)
+	{
+		int const policy = gPolicy == Policy::FIFO ? SCHED_FIFO : SCHED_RR;
+
+		sched_param param;
+		param.sched_priority = std::max(
+				sched_get_priority_min(policy),
+				std::min(sched_get_priority_max(policy), gPriority - (worker ? 1 : 0))
+				);
+
+		int const error = pthread_setschedparam(pthread_self(), policy, &param);
+		if (error != 0 && gWarnedPolicy.test_and_set() == false)
+			fprintf(stderr, "RealTime [warn] %s: could not set real-time scheduling (%s); "
+					"running at normal priority.\n", name, strerror(error));
+	}
+
+#ifdef __linux__
+	if (gCores.empty() == false)
+	{
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for (int core : gCores)
+			if (core < CPU_SETSIZE)
+				CPU_SET(core, &set);
+
+		int const error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+		if (error != 0 && gWarnedAffinity.test_and_set() == false)
+			fprintf(stderr, "RealTime [warn] %s: could not pin to the requested cores (%s); "
+					"leaving it free.\n", name, strerror(error));
+	}
+#endif
+#else
+	(void) name;
+	(void) worker;
+#endif
+}
+
+void RealTime::lock_process()
+{
+#ifdef REAL_TIME_POSIX
+	if (gLocking != Locking::ALL)
+		return;
+
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0 && gWarnedLock.test_and_set() == false)
+		fprintf(stderr, "RealTime [warn] Could not lock process memory (%s); "
+				"raise RLIMIT_MEMLOCK or use \"samples\".\n", strerror(errno));
+#endif
+}
+
+size_t RealTime::lock(void const *data, size_t bytes)
+{
+	if (data == nullptr || bytes == 0)
+		return 0;
+
+	size_t locked = 0;
+
+#ifdef REAL_TIME_POSIX
+	if (gLocking == Locking::SAMPLES)
+	{
+		// mlock wants a page-aligned address.
+		static const size_t page = sysconf(_SC_PAGESIZE);
+		uintptr_t const begin = reinterpret_cast<uintptr_t>(data) / page * page;
+		uintptr_t const end   = reinterpret_cast<uintptr_t>(data) + bytes;
+
+		if (mlock(reinterpret_cast<void const*>(begin), end - begin) == 0)
+			locked = bytes;
+		else if (gWarnedLock.test_and_set() == false)
+			fprintf(stderr, "RealTime [warn] Could not lock sample data (%s); "
+					"raise RLIMIT_MEMLOCK to keep samples resident.\n", strerror(errno));
+	}
+
+	// Locked ranges are already faulted in; read a byte of every page
+	// of the others.
+	if (gPrefault && locked == 0)
+	{
+		static const size_t page = sysconf(_SC_PAGESIZE);
+		unsigned char const *p = static_cast<unsigned char const*>(data);
+		volatile unsigned char sink = 0;
+
+		for (size_t i = 0; i < bytes; i += page)
+			sink ^= p[i];
+		sink ^= p[bytes - 1];
+	}
+#else
+	(void) bytes;
+#endif
+
+	return locked;
+}
+
+void RealTime::unlock(void const *data, size_t bytes)
+{
+	if (data == nullptr || bytes == 0)
+		return;
+
+#ifdef REAL_TIME_POSIX
+	if (gLocking != Locking::SAMPLES)
+		return;
+
+	// munlock wants a page-aligned address, too.
+	static const size_t page = sysconf(_SC_PAGESIZE);
+	uintptr_t const begin = reinterpret_cast<uintptr_t>(data) / page * page;
+	uintptr_t const end   = reinterpret_cast<uintptr_t>(data) + bytes;
+
+	munlock(reinterpret_cast<void const*>(begin), end - begin);
+#endif
+}
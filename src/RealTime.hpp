@@ -0,0 +1,72 @@
+//  RealTime.hpp :: Real-time scheduling and memory locking for audio threads
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#ifndef REAL_TIME_H
+#define REAL_TIME_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * Settings applied to threads and memory the audio engine cannot afford
+ * to wait on.
+ *
+ * Every call falls back to leaving things as they are when the system
+ * does not allow the change, e.g. without `CAP_SYS_NICE` or with a low
+ * `RLIMIT_MEMLOCK`, and logs why on the first failure of its kind.
+ */
+class RealTime
+{
+public:
+	//! Scheduling policy for audio threads.
+	enum class Policy : unsigned char {
+		NORMAL, //!< Leave the default time-sharing policy.
+		FIFO,   //!< SCHED_FIFO
+		RR      //!< SCHED_RR
+	};
+
+	//! Memory to lock into RAM.
+	enum class Locking : unsigned char {
+		NONE,       //!< Lock nothing.
+		SAMPLES,    //!< Lock sample data once a chart is loaded.
+		ALL         //!< Lock the whole process, including later allocations.
+	};
+
+	static Policy           gPolicy;    //!< Scheduling policy for audio threads.
+	static int              gPriority;  //!< Priority of the mixer thread; workers run one below.
+	static std::vector<int> gCores;     //!< Cores to pin audio threads to; empty leaves them free.
+	static Locking          gLocking;   //!< Memory to lock.
+	static bool             gPrefault;  //!< Touch sample data after loading.
+
+	//! Parses a policy name: "normal", "fifo" or "rr".
+	static bool parse(std::string const &name, Policy &policy);
+
+	//! Parses a locking mode name: "none", "samples" or "all".
+	static bool parse(std::string const &name, Locking &locking);
+
+	//! Parses a comma-separated list of core numbers.
+	static bool parse(std::string const &list, std::vector<int> &cores);
+
+	/** Applies the scheduling policy and core affinity to the calling thread.
+	 *  \param name   Thread name used in diagnostics.
+	 *  \param worker Run one priority level below the mixer.
+	 */
+	static void apply(char const *name, bool worker = false);
+
+	//! Locks the whole process into RAM if configured to.
+	static void lock_process();
+
+	/** Locks a range of sample data into RAM and faults it in, as
+	 *  configured. \return Number of bytes locked.
+	 */
+	static size_t lock(void const *data, size_t bytes);
+
+	/** Unlocks a range of sample data locked by `lock`, e.g. before it is
+	 *  freed. Locks are per page and do not nest: data sharing a page
+	 *  with the range may become swappable again.
+	 */
+	static void unlock(void const *data, size_t bytes);
+};
+
+#endif
@@ -0,0 +1,220 @@
+//  SampleCache.cpp :: Process-wide decoded sample cache
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#include "SampleCache.hpp"
+
+#include <sys/stat.h>
+#include <tuple>
+
+bool SampleCache::Source::operator< (Source const &other) const
+{
+	return std::tie(device, inode, mtime, size)
+		<  std::tie(other.device, other.inode, other.mtime, other.size);
+}
+
+bool SampleCache::identify(std::string const &path, Source &source)
+{
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0)
+		return false;
+
+	source.device = st.st_dev;
+	source.inode  = st.st_ino;
+	source.mtime  = st.st_mtime;
+	source.size   = st.st_size;
+	return true;
+}
+
+SampleCache& SampleCache::get()
+{
+	static SampleCache cache;
+	return cache;
+}
+
+SampleCache::SampleCache()
+	: mBytes (0)
+	, mBudget(256 << 20)
+{ }
+
+void SampleCache::touch(Entry &entry)
+{
+	mRecent.splice(mRecent.begin(), mRecent, entry.recent);
+}
+
+void SampleCache::erase(std::map<Key, Entry>::iterator it)
+{
+	mSources.erase(it->first.first); // Source is no longer cached in whole.
+	mRecent .erase(it->second.recent);
+	mBytes -= it->second.bytes;
+
+	if (it->second.arena != nullptr) {
+		auto use = mArenas.find(it->second.arena);
+		if (--use->second.entries == 0) {
+			mBytes -= use->second.bytes;
+			mArenas.erase(use);
+		}
+	}
+
+	mEntries.erase(it);
+}
+
+void SampleCache::erase(Source const &source)
+{
+	auto it = mEntries.lower_bound(Key(source, 0));
+	while (it != mEntries.end() && !(source < it->first.first))
+		erase(it++);
+}
+
+void SampleCache::erase(awe::Aarena const *arena)
+{
+	for (auto it = mEntries.begin(); it != mEntries.end(); )
+	{
+		if (it->second.arena == arena)
+			erase(it++);
+		else
+			it++;
+	}
+}
+
+bool SampleCache::unshared(awe::Aarena const *arena) const
+{
+	for (auto const &pair : mEntries)
+		if (pair.second.arena == arena && pair.second.sample.isUnshared() == false)
+			return false;
+
+	return true;
+}
+
+bool SampleCache::unshared(Source const &source) const
+{
+	auto it = mEntries.lower_bound(Key(source, 0));
+	for (; it != mEntries.end() && !(source < it->first.first); it++)
+		if (it->second.sample.isUnshared() == false)
+			return false;
+
+	return true;
+}
+
+void SampleCache::trim()
+{
+	auto key = mRecent.end();
+	while (mBytes > mBudget && key != mRecent.begin())
+	{
+		Key const victim = *(--key);
+
+		if (mSources.count(victim.first) != 0)
+		{
+			// Part of a source cached in whole can never be fetched again.
+			if (unshared(victim.first) == false)
+				continue;
+
+			erase(victim.first);
+			key = mRecent.end(); // Other keys of the source may have been next.
+			continue;
+		}
+
+		auto it = mEntries.find(victim);
+
+		if (it->second.arena != nullptr)
+		{
+			// The arena is only freed once none of its slices is cached.
+			if (unshared(it->second.arena) == false)
+				continue;
+
+			erase(it->second.arena);
+			key = mRecent.end();
+			continue;
+		}
+
+		// Samples still held by a sample map cannot be freed by evicting them.
+		if (it->second.sample.isUnshared() == false)
+			continue;
+
+		key = std::next(key);
+		erase(it);
+	}
+}
+
+void SampleCache::setBudget(size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mBudget = bytes;
+	trim();
+}
+
+bool SampleCache::fetch(Source const &source, unsigned int id, Sample &sample)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	auto it = mEntries.find(Key(source, id));
+	if (it == mEntries.end())
+		return false;
+
+	touch(it->second);
+	sample = it->second.sample;
+	return true;
+}
+
+bool SampleCache::fetch(Source const &source, SampleMap &map)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	if (mSources.count(source) == 0)
+		return false;
+
+	auto it = mEntries.lower_bound(Key(source, 0));
+	for (; it != mEntries.end() && !(source < it->first.first); it++)
+	{
+		touch(it->second);
+		map[it->first.second] = it->second.sample;
+	}
+
+	return true;
+}
+
+void SampleCache::store(Source const &source, unsigned int id, Sample const &sample)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	if (sample.hasData() == false)
+		return;
+
+	auto it = mEntries.find(Key(source, id));
+	if (it != mEntries.end())
+		erase(it);
+
+	mRecent.push_front(Key(source, id));
+
+	std::shared_ptr<awe::Aarena> const arena = awe::Aarena::of(sample.getData());
+
+	Entry entry = { sample, arena ? 0 : sample.getMemoryUsage(), mRecent.begin(), arena.get() };
+	mEntries.emplace(Key(source, id), entry);
+	mBytes += entry.bytes;
+
+	if (arena) {
+		ArenaUse &use = mArenas[arena.get()];
+		if (use.entries++ == 0) {
+			use.bytes = arena->getCapacity();
+			mBytes   += use.bytes;
+		}
+	}
+
+	trim();
+}
+
+void SampleCache::store(Source const &source, SampleMap const &map)
+{
+	for (auto const &pair : map)
+		store(source, pair.first, pair.second);
+
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	// Samples of this source may have been evicted while storing the rest.
+	size_t count = 0;
+	auto it = mEntries.lower_bound(Key(source, 0));
+	for (; it != mEntries.end() && !(source < it->first.first); it++)
+		count++;
+
+	if (count == map.size())
+		mSources[source] = count;
+}
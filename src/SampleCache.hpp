@@ -0,0 +1,122 @@
+//  SampleCache.hpp :: Process-wide decoded sample cache
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#ifndef SAMPLE_CACHE_H
+#define SAMPLE_CACHE_H
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "AudioManager.hpp"
+#include "libawe/Arena.hpp"
+
+/**
+ * Cache of decoded samples shared by every chart in the process.
+ *
+ * Samples are keyed by the identity of the file they were decoded from
+ * and by their chart sample ID, so the charts of an OJN sharing one OJM,
+ * as well as retries of the same chart, reuse the decoded buffers instead
+ * of decoding them again.
+ *
+ * The cache keeps the total size of cached buffers under a budget by
+ * evicting the least recently used samples. Buffers that are still held
+ * by a sample map elsewhere are never evicted; they only count towards
+ * the budget until they are released. Sources cached in whole are only
+ * ever fetched in whole, so they are evicted in whole as well.
+ *
+ * A sample packed into an arena keeps the whole arena alive, so cached
+ * slices are charged the capacity of their arena, once per arena, and
+ * are evicted together with the other cached slices of that arena.
+ */
+class SampleCache
+{
+public:
+	//! Identity of a sample source file; changes when the file does.
+	struct Source
+	{
+		uint64_t device;
+		uint64_t inode;
+		int64_t  mtime;
+		uint64_t size;
+
+		bool operator< (Source const &other) const;
+	};
+
+	/** Identifies a sample source file.
+	 *  \return false if the file could not be inspected.
+	 */
+	static bool identify(std::string const &path, Source &source);
+
+	//! @return The process-wide sample cache.
+	static SampleCache& get();
+
+private:
+	using Key = std::pair<Source, unsigned int>;
+	using LRU = std::list<Key>;
+
+	struct Entry
+	{
+		Sample        sample;
+		size_t        bytes;    //!< Size charged for the sample alone.
+		LRU::iterator recent;
+		awe::Aarena const *arena; //!< Arena the sample is a slice of, or nullptr.
+	};
+
+	//! Cached slices of an arena.
+	struct ArenaUse
+	{
+		size_t bytes;           //!< Size charged for the arena.
+		size_t entries;         //!< Number of cached slices.
+	};
+
+	std::mutex                mMutex;
+	std::map<Key, Entry>      mEntries;
+	std::map<Source, size_t>  mSources;   //!< Sources cached in whole and their sample count.
+	std::map<awe::Aarena const*, ArenaUse> mArenas;
+	LRU                       mRecent;    //!< Keys ordered from the most recently used.
+	size_t                    mBytes;     //!< Total size of cached buffers.
+	size_t                    mBudget;    //!< Size to keep cached buffers under.
+
+	SampleCache();
+
+	void touch(Entry &entry);
+	void erase(std::map<Key, Entry>::iterator it);
+	void erase(Source const &source);
+	void erase(awe::Aarena const *arena);
+
+	//! @return true if no sample of a source is held outside of the cache.
+	bool unshared(Source const &source) const;
+
+	//! @return true if no cached slice of an arena is held outside of the cache.
+	bool unshared(awe::Aarena const *arena) const;
+	void trim();
+
+public:
+	SampleCache(SampleCache const &) = delete;
+	SampleCache& operator=(SampleCache const &) = delete;
+
+	void   setBudget(size_t bytes);
+	size_t getBudget() const { return mBudget; }
+	size_t getBytes () const { return mBytes; }
+
+	/** Retrieves a single sample.
+	 *  \return false if the sample is not cached.
+	 */
+	bool fetch(Source const &source, unsigned int id, Sample &sample);
+
+	/** Retrieves every sample of a source cached with `store(Source, SampleMap)`.
+	 *  \return false if the source is not cached in whole.
+	 */
+	bool fetch(Source const &source, SampleMap &map);
+
+	//! Caches a single sample.
+	void store(Source const &source, unsigned int id, Sample const &sample);
+
+	//! Caches every sample decoded from a source.
+	void store(Source const &source, SampleMap const &map);
+};
+
+#endif
@@ -0,0 +1,173 @@
+#include <cassert>
+#include <cstdio>
+#include "SampleCache.hpp"
+#include "libawe/Arena.hpp"
+
+static const size_t VALUES = 4096;
+static const size_t BYTES  = VALUES * sizeof(awe::Aint);
+
+static Sample make_sample()
+{
+	auto pcm = std::make_shared<awe::AiBuffer>(VALUES, awe::Aint(1));
+	return Sample(pcm, 2, 1.0f, 44100, "Cache test");
+}
+
+// Samples held only by the cache are evicted to keep it under budget.
+static void test_budget(SampleCache &cache)
+{
+	SampleCache::Source const source = { 1, 1, 0, 0 };
+
+	cache.setBudget(4 * BYTES);
+	for (unsigned int id = 0; id < 16; id++)
+		cache.store(source, id, make_sample());
+
+	Sample sample;
+	assert(cache.getBytes() <= cache.getBudget());
+	bool const newest = cache.fetch(source, 15, sample);
+	bool const oldest = cache.fetch(source, 0, sample);
+	assert(newest == true);
+	assert(oldest == false);
+	sample.drop();
+
+	cache.setBudget(0);
+	assert(cache.getBytes() == 0);
+}
+
+// Samples still held elsewhere stay cached past the budget.
+static void test_held(SampleCache &cache)
+{
+	SampleCache::Source const source = { 1, 2, 0, 0 };
+
+	cache.setBudget(4 * BYTES);
+
+	Sample const held = make_sample();
+	cache.store(source, 0, held);
+	for (unsigned int id = 1; id < 16; id++)
+		cache.store(source, id, make_sample());
+
+	Sample sample;
+	bool const fetched = cache.fetch(source, 0, sample);
+	assert(fetched == true);
+	assert(cache.getBytes() <= cache.getBudget() + BYTES);
+	sample.drop();
+
+	cache.setBudget(0);
+	assert(cache.getBytes() == BYTES);
+}
+
+// An arena slice is evicted even while other slices of its slab live.
+static void test_arena(SampleCache &cache)
+{
+	SampleCache::Source const source = { 1, 3, 0, 0 };
+	std::shared_ptr<awe::Aarena> arena = awe::Aarena::create();
+
+	Sample kept = make_sample();
+	Sample gone = make_sample();
+	bool const packed = kept.pack(*arena) && gone.pack(*arena);
+	assert(packed);
+	assert(arena->getSlabCount() == 1);
+
+	cache.setBudget(4 * BYTES);
+	cache.store(source, 0, gone);
+	gone.drop();
+
+	for (unsigned int id = 1; id < 16; id++)
+		cache.store(source, id, make_sample());
+
+	Sample sample;
+	bool const fetched = cache.fetch(source, 0, sample);
+	assert(fetched == false);
+	assert(kept.isUnshared());
+
+	cache.setBudget(0);
+	assert(cache.getBytes() == 0);
+}
+
+// A source cached in whole is evicted in whole, and can be cached again.
+static void test_source(SampleCache &cache)
+{
+	SampleCache::Source const whole = { 1, 4, 0, 0 };
+	SampleCache::Source const other = { 1, 5, 0, 0 };
+
+	cache.setBudget(8 * BYTES);
+	{
+		SampleMap map;
+		for (unsigned int id = 0; id < 8; id++)
+			map[id] = make_sample();
+		cache.store(whole, map);
+	}
+
+	// Half of the budget goes to another source.
+	for (unsigned int id = 0; id < 4; id++)
+		cache.store(other, id, make_sample());
+
+	SampleMap map;
+	bool const fetched = cache.fetch(whole, map);
+	assert(fetched == false);
+	assert(map.empty());
+	assert(cache.getBytes() == 4 * BYTES);
+
+	for (unsigned int id = 0; id < 8; id++) {
+		Sample sample;
+		bool const left = cache.fetch(whole, id, sample);
+		assert(left == false);
+	}
+
+	for (unsigned int id = 0; id < 8; id++)
+		map[id] = make_sample();
+	cache.store(whole, map);
+	map.clear();
+
+	bool const refetched = cache.fetch(whole, map);
+	assert(refetched == true);
+	assert(map.size() == 8);
+	map.clear();
+
+	cache.setBudget(0);
+	assert(cache.getBytes() == 0);
+}
+
+// Cached slices are charged their whole arena, and evicted together.
+static void test_arena_charge(SampleCache &cache)
+{
+	SampleCache::Source const source = { 1, 6, 0, 0 };
+	std::shared_ptr<awe::Aarena> arena = awe::Aarena::create(2 * BYTES);
+
+	Sample first  = make_sample();
+	Sample second = make_sample();
+	bool const packed = first.pack(*arena) && second.pack(*arena);
+	assert(packed);
+
+	cache.setBudget(8 * BYTES);
+	cache.store(source, 0, first);
+	cache.store(source, 1, second);
+	assert(cache.getBytes() == arena->getCapacity());
+	first .drop();
+	second.drop();
+
+	// Pushes the older slice out, and the newer one with it.
+	for (unsigned int id = 2; id < 9; id++)
+		cache.store(source, id, make_sample());
+
+	Sample sample;
+	bool const fetched = cache.fetch(source, 1, sample);
+	assert(fetched == false);
+	assert(cache.getBytes() == 7 * BYTES);
+
+	cache.setBudget(0);
+	assert(cache.getBytes() == 0);
+}
+
+int main()
+{
+	SampleCache &cache = SampleCache::get();
+
+	test_budget(cache);
+	test_held  (cache);
+	test_arena (cache);
+	test_source(cache);
+	test_arena_charge(cache);
+
+	fprintf(stdout, "SampleCache: all tests passed.\n");
+	return 0;
+}
@@ -0,0 +1,134 @@
+//  SampleCompactor.cpp :: Post-decode sample map compaction
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#include "SampleCompactor.hpp"
+
+#include <cstdio>
+#include <set>
+#include <unordered_map>
+
+bool SampleCompactor::gTrimSilence     = true;
+bool SampleCompactor::gMergeDuplicates = true;
+
+//! @return Total size of distinct buffers held by a sample map.
+static size_t count_bytes(SampleMap const &map)
+{
+	std::set<void const*> seen;
+	size_t bytes = 0;
+
+	for (auto const &pair : map) {
+		Sample const &sample = pair.second;
+		void const *data = sample.isStreamed()
+			? static_cast<void const*>(sample.cgetEncoded().get())
+			: static_cast<void const*>(sample.getData    ().get());
+
+		if (data && seen.insert(data).second)
+			bytes += sample.getMemoryUsage();
+	}
+
+	return bytes;
+}
+
+void SampleCompactor::Report::print(std::string const &name) const
+{
+	fprintf(stderr,
+			"SampleCompactor [info] %s: %zu samples, %.2f MiB -> %.2f MiB "
+			"(%zu silent frames trimmed, %zu duplicates merged).\n",
+			name.c_str(), samples,
+			bytesBefore / 1048576.0, bytesAfter / 1048576.0,
+			framesTrimmed, merged
+		   );
+}
+
+SampleCompactor::SampleCompactor()
+	: mOriginals()
+	, mReport   { 0, 0, 0, 0, 0 }
+{ }
+
+bool SampleCompactor::compact(Sample &sample)
+{
+	mReport.samples++;
+	mReport.bytesBefore   += sample.getMemoryUsage();
+	mReport.framesTrimmed += trim(sample);
+
+	if (gMergeDuplicates && sample.hasData())
+	{
+		auto it = mOriginals.find(sample.getMemoryUsage());
+		if (it != mOriginals.end())
+		{
+			uint64_t const hash = sample.hash_content();
+
+			for (Original &original : it->second)
+			{
+				if (original.hashed == false) {
+					original.hash   = original.sample.hash_content();
+					original.hashed = true;
+				}
+
+				if (original.hash == hash && original.sample.is_identical(sample)) {
+					sample.share(original.sample);
+					mReport.merged++;
+					return true;
+				}
+			}
+		}
+	}
+
+	mReport.bytesAfter += sample.getMemoryUsage();
+	return false;
+}
+
+void SampleCompactor::keep(Sample const &sample)
+{
+	if (gMergeDuplicates && sample.hasData())
+		mOriginals[sample.getMemoryUsage()].push_back(Original { sample, 0, false });
+}
+
+size_t SampleCompactor::trim(Sample &sample)
+{
+	return gTrimSilence ? sample.trim_silence() : 0;
+}
+
+SampleCompactor::Report SampleCompactor::compact(SampleMap &map)
+{
+	Report report = { map.size(), count_bytes(map), 0, 0, 0 };
+
+	for (auto &pair : map)
+		report.framesTrimmed += trim(pair.second);
+
+	if (gMergeDuplicates)
+	{
+		// Hash to the samples first seen with that hash.
+		std::unordered_map< uint64_t, std::vector<Sample*> > originals;
+
+		for (auto &pair : map)
+		{
+			Sample &sample = pair.second;
+			if (sample.hasData() == false)
+				continue;
+
+			std::vector<Sample*> &candidates = originals[sample.hash_content()];
+
+			bool merged = false;
+			for (Sample* original : candidates)
+			{
+				if (original->is_identical(sample))
+				{
+					if (original->getData() != sample.getData() || original->cgetEncoded() != sample.cgetEncoded()) {
+						sample.share(*original);
+						report.merged++;
+					}
+
+					merged = true;
+					break;
+				}
+			}
+
+			if (merged == false)
+				candidates.push_back(&sample);
+		}
+	}
+
+	report.bytesAfter = count_bytes(map);
+	return report;
+}
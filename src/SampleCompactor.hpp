@@ -0,0 +1,79 @@
+//  SampleCompactor.hpp :: Post-decode sample map compaction
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#ifndef SAMPLE_COMPACTOR_H
+#define SAMPLE_COMPACTOR_H
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "AudioManager.hpp"
+
+/**
+ * Optional stage run on freshly decoded samples.
+ *
+ * Trailing digital silence is trimmed off every sample, which also ends
+ * voices playing them sooner, and samples holding identical audio data
+ * are made to share a single buffer.
+ *
+ * A whole map can be compacted at once, or samples can be compacted one
+ * at a time as they are decoded, before anything else holds on to them.
+ */
+class SampleCompactor
+{
+public:
+	static bool gTrimSilence;       //!< Trim trailing silence.
+	static bool gMergeDuplicates;   //!< Share buffers of identical samples.
+
+	struct Report
+	{
+		size_t samples;         //!< Number of samples in the map.
+		size_t bytesBefore;     //!< Size of distinct buffers before compaction.
+		size_t bytesAfter;      //!< Size of distinct buffers after compaction.
+		size_t framesTrimmed;   //!< Number of silent frames removed.
+		size_t merged;          //!< Number of samples now sharing another's buffer.
+
+		void print(std::string const &name) const;
+	};
+
+private:
+	struct Original
+	{
+		Sample   sample;
+		uint64_t hash;      //!< Content hash; only valid if `hashed`.
+		bool     hashed;
+	};
+
+	/** Size in bytes to the samples kept with that size. Only samples of
+	 *  the same size as a compacted one are ever hashed, so keeping
+	 *  samples costs nothing until a possible duplicate turns up.
+	 */
+	std::unordered_map< size_t, std::vector<Original> > mOriginals;
+
+	Report mReport;
+
+public:
+	SampleCompactor();
+
+	/** Trims a freshly decoded sample and makes it share the buffer of
+	 *  an identical sample kept before it.
+	 *  \return true if the sample now shares another sample's buffer.
+	 */
+	bool compact(Sample &sample);
+
+	/** Lets samples compacted later share the buffer of this one.
+	 *  Call once the sample holds its final buffer, e.g. once packed.
+	 */
+	void keep(Sample const &sample);
+
+	//! @return Report on every sample compacted so far.
+	inline Report const &getReport() const { return mReport; }
+
+	//! Trims a single sample if enabled. \return Number of frames removed.
+	static size_t trim(Sample &sample);
+
+	//! Compacts every sample in a sample map.
+	static Report compact(SampleMap &map);
+};
+
+#endif
@@ -0,0 +1,410 @@
+//  SampleDiskCache.cpp :: Persistent cache of decoded samples
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#include "SampleDiskCache.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include <ClanLib/core.h>
+#include "soxr/src/soxr.h"
+
+#include "MappedFile.hpp"
+#include "SampleCache.hpp"
+
+#if !( defined(_WIN32) || defined(_WIN64) )
+#include <pthread.h> // POSIX Thread naming
+#endif
+
+static char const MAGIC[8] = { 'D', 'J', 'P', 'C', 'M', 'S', 'C', '\0' };
+
+//! Data offsets are aligned to this many bytes.
+static size_t const ALIGNMENT = 64;
+
+//! Deleter of a record's PCM data; frees nothing, but keeps the mapping alive.
+struct RecordOwner
+{
+	MappedFile::Pointer file;
+	void operator()(awe::Aint const *) const { }
+};
+
+//! 64-bit FNV-1a hash.
+static uint64_t fnv1a(void const *data, size_t size, uint64_t hash = 0xcbf29ce484222325ULL)
+{
+	uint8_t const *p = static_cast<uint8_t const *>(data);
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ p[i]) * 0x100000001b3ULL;
+	return hash;
+}
+
+SampleDiskCache& SampleDiskCache::get()
+{
+	static SampleDiskCache cache;
+	return cache;
+}
+
+SampleDiskCache::SampleDiskCache()
+	: mEnabled(false)
+	, mPath   ("cache")
+	, mRate   (48000)
+	, mRunning(false)
+{ }
+
+SampleDiskCache::~SampleDiskCache()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mRunning = false;
+	}
+
+	mWake.notify_all();
+	if (mThread.joinable())
+		mThread.join();
+}
+
+void SampleDiskCache::run()
+{
+#if !( defined(_WIN32) || defined(_WIN64) )
+	pthread_setname_np(pthread_self(), "Disk Cache");
+#endif
+
+	std::unique_lock<std::mutex> lock(mMutex);
+
+	while (true)
+	{
+		mWake.wait(lock, [this] { return mQueue.empty() == false || mRunning == false; });
+
+		// Queued files are still written when stopping.
+		if (mQueue.empty())
+			return;
+
+		Job job = std::move(mQueue.front());
+		mQueue.pop_front();
+
+		lock.unlock();
+		write(job.cache, job.hash, job.rate, std::move(job.map));
+		lock.lock();
+
+		mPending.erase(job.cache);
+	}
+}
+
+void SampleDiskCache::configure(bool enabled, std::string const &path, unsigned long rate)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+
+	mEnabled = enabled;
+	mPath    = path;
+	mRate    = rate;
+
+	if (mEnabled && clan::FileHelp::file_exists(mPath) == false)
+		clan::Directory::create(mPath, true);
+}
+
+bool SampleDiskCache::locate(std::string const &source, std::string &cache, uint64_t &hash) const
+{
+	SampleCache::Source identity;
+	if (SampleCache::identify(source, identity) == false)
+		return false;
+
+	uint64_t const name = fnv1a(source.data(), source.size());
+
+	hash = name;
+	hash = fnv1a(&identity.size , sizeof(identity.size ), hash);
+	hash = fnv1a(&identity.mtime, sizeof(identity.mtime), hash);
+
+	char file[24];
+	snprintf(file, sizeof(file), "%016llx.pcm", static_cast<unsigned long long>(name));
+
+	cache = clan::PathHelp::add_trailing_slash(mPath) + file;
+	return true;
+}
+
+bool SampleDiskCache::load(std::string const &source, SampleMap &map)
+{
+	if (mEnabled == false)
+		return false;
+
+	std::string cache;
+	uint64_t    hash;
+	if (locate(source, cache, hash) == false)
+		return false;
+
+	MappedFile::Pointer file = MappedFile::open(cache);
+	if (file == nullptr)
+		return false;
+
+	Header const *header = file->as<Header>(0);
+	if (header == nullptr
+			|| memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0
+			|| header->version    != VERSION
+			|| header->rate       != mRate
+			|| header->sourceHash != hash)
+		return false;
+
+	Record const *records = reinterpret_cast<Record const *>(
+			file->at(sizeof(Header), header->count * sizeof(Record))
+			);
+	if (records == nullptr)
+		return false;
+
+	SampleMap loaded;
+	std::map<uint64_t, unsigned int> blobs; //!< Data offset to the first sample loaded from it.
+
+	for (uint32_t i = 0; i < header->count; i++)
+	{
+		Record const &record = records[i];
+
+		size_t const length = record.frames * record.channels;
+		size_t const size   = record.format == ENCODED ? record.size : length * sizeof(awe::Aint);
+
+		uint8_t const *data = file->at(record.offset, size);
+		if (data == nullptr || record.channels == 0 || record.size != size) {
+			fprintf(stderr, "SampleDiskCache [warn] Ignoring truncated cache file %s.\n", cache.c_str());
+			return false;
+		}
+
+		std::string const name(record.name, strnlen(record.name, sizeof(record.name)));
+
+		std::shared_ptr<awe::AiBuffer> none;
+		Sample sample(none, record.channels, record.peak, record.rate, name);
+
+		auto const blob = record.size > 0 ? blobs.find(record.offset) : blobs.end();
+		if (blob != blobs.end()) {
+			// Written once for samples that shared a buffer; share it again.
+			sample.share(loaded[blob->second]);
+		} else if (record.format == PCM_INT16) {
+			// Play straight from the mapping; each record gets a use count
+			// of its own, so that the sample cache can tell who holds it.
+			sample.setData(
+					std::shared_ptr<awe::Aint const>(reinterpret_cast<awe::Aint const *>(data), RecordOwner { file }),
+					length, record.peak
+					);
+		} else {
+			// Compressed data is small and decoded from a buffer of its own.
+			sample.setEncoded(
+					std::make_shared< const std::vector<char> >(data, data + size),
+					record.frames
+					);
+		}
+
+		loaded[record.id] = sample;
+		if (record.size > 0)
+			blobs.insert(std::make_pair(record.offset, record.id));
+	}
+
+	// Samples play from the mapping; have it read in before they do.
+	file->advise(MappedFile::Advice::WILLNEED);
+
+	for (auto &pair : loaded)
+		map[pair.first] = pair.second;
+
+	return true;
+}
+
+void SampleDiskCache::save(std::string const &source, SampleMap const &map)
+{
+	if (mEnabled == false)
+		return;
+
+	std::string cache;
+	uint64_t    hash;
+	if (locate(source, cache, hash) == false)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (mPending.insert(cache).second == false)
+			return;
+
+		// The copied map shares sample buffers with the original.
+		mQueue.push_back(Job { cache, hash, mRate, map });
+
+		if (mRunning == false) {
+			mRunning = true;
+			mThread  = std::thread(&SampleDiskCache::run, this);
+		}
+	}
+
+	mWake.notify_one();
+}
+
+void SampleDiskCache::write(std::string cache, uint64_t hash, unsigned long rate, SampleMap map)
+{
+	std::vector<Record>                 records;
+	std::vector< std::vector<char> >    data;
+	std::vector<size_t>                 owners;  //!< Record whose data each record points at.
+	std::map<void const*, size_t>       written; //!< Buffer to the record holding it.
+
+	for (auto const &pair : map)
+	{
+		Sample const &sample = pair.second;
+		if (sample.hasData() == false || sample.getChannelCount() == 0 || sample.getSampleRate() == 0)
+			continue;
+
+		Record record;
+		memset(&record, 0, sizeof(Record));
+
+		void const *buffer = sample.isStreamed()
+			? static_cast<void const*>(sample.cgetEncoded().get())
+			: static_cast<void const*>(sample.getData    ().get());
+
+		auto const shared = written.find(buffer);
+		if (shared != written.end())
+		{
+			// Merged duplicates point at the data of the first one.
+			record = records[shared->second];
+			record.id = pair.first;
+			memset(record.name, 0, sizeof(record.name));
+			strncpy(record.name, sample.getName().c_str(), sizeof(record.name));
+
+			data.emplace_back();
+			owners.push_back(shared->second);
+			records.push_back(record);
+			continue;
+		}
+
+		record.id       = pair.first;
+		record.channels = sample.getChannelCount();
+		record.peak     = sample.getPeak();
+		strncpy(record.name, sample.getName().c_str(), sizeof(record.name));
+
+		if (sample.isStreamed())
+		{
+			// Streamed samples stay compressed; they are resampled as they play.
+			auto const encoded = sample.cgetEncoded();
+
+			data.emplace_back(encoded->begin(), encoded->end());
+			record.format = ENCODED;
+			record.rate   = sample.getSampleRate();
+			record.frames = sample.getFrameCount();
+			record.size   = encoded->size();
+			written[buffer] = records.size();
+			owners.push_back(records.size());
+			records.push_back(record);
+			continue;
+		}
+
+		auto const   source = sample.getData();
+		size_t const frames = sample.getFrameCount();
+
+		std::vector<awe::Aint> pcm;
+
+		if (rate == 0 || sample.getSampleRate() == rate)
+		{
+			pcm.assign(source.get(), source.get() + frames * record.channels);
+			record.frames = frames;
+			record.rate   = sample.getSampleRate();
+		}
+		else
+		{
+			double const ratio = static_cast<double>(rate) / sample.getSampleRate();
+			size_t const olen  = static_cast<size_t>(std::ceil(frames * ratio)) + 1;
+			size_t       odone = 0;
+
+			std::vector<float> resampled(olen * record.channels);
+
+			soxr_io_spec_t      const soxIOs = soxr_io_spec(SOXR_INT16_I, SOXR_FLOAT32_I);
+			soxr_quality_spec_t const soxQs  = soxr_quality_spec(SOXR_HQ, 0);
+
+			soxr_error_t error = soxr_oneshot(
+					sample.getSampleRate(), rate, record.channels,
+					source.get(), frames, nullptr,
+					resampled.data(), olen, &odone,
+					&soxIOs, &soxQs, nullptr
+					);
+
+			if (error) {
+				fprintf(stderr, "SampleDiskCache [error] Could not resample %s: %s\n", sample.getName().c_str(), error);
+				continue;
+			}
+
+			resampled.resize(odone * record.channels);
+
+			// Resampling may overshoot; fold the excess into the peak multiplier.
+			float scale = 1.0f;
+			for (float const &v : resampled)
+				scale = std::max(scale, std::fabs(v));
+
+			pcm.resize(resampled.size());
+			for (size_t i = 0; i < resampled.size(); i++)
+				pcm[i] = awe::to_Aint(resampled[i] / scale);
+
+			record.frames = odone;
+			record.rate   = rate;
+			record.peak  *= scale;
+		}
+
+		char const *bytes = reinterpret_cast<char const*>(pcm.data());
+		data.emplace_back(bytes, bytes + pcm.size() * sizeof(awe::Aint));
+
+		record.format = PCM_INT16;
+		record.size   = data.back().size();
+		written[buffer] = records.size();
+		owners.push_back(records.size());
+		records.push_back(record);
+	}
+
+	Header header;
+	memset(&header, 0, sizeof(Header));
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version    = VERSION;
+	header.rate       = rate;
+	header.sourceHash = hash;
+	header.count      = records.size();
+
+	size_t offset = sizeof(Header) + records.size() * sizeof(Record);
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		if (owners[i] != i) {
+			records[i].offset = records[owners[i]].offset;
+			continue;
+		}
+
+		offset = (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+		records[i].offset = offset;
+		offset += records[i].size;
+	}
+
+	// Write into a temporary file first so that a half-written cache file
+	// is never picked up by `load`.
+	std::string const temp = cache + ".tmp";
+
+	FILE* file = fopen(temp.c_str(), "wb");
+	if (file == nullptr) {
+		fprintf(stderr, "SampleDiskCache [error] Could not create %s.\n", temp.c_str());
+		return;
+	}
+
+	bool ok = fwrite(&header, sizeof(Header), 1, file) == 1
+		&& (records.empty() || fwrite(records.data(), sizeof(Record), records.size(), file) == records.size());
+
+	for (size_t i = 0; ok && i < records.size(); i++)
+	{
+		if (owners[i] != i)
+			continue;
+
+		static char const zero[ALIGNMENT] = { 0 };
+		size_t const pad = records[i].offset - ftell(file);
+
+		ok = (pad == 0 || fwrite(zero, 1, pad, file) == pad)
+			&& (data[i].empty() || fwrite(data[i].data(), 1, data[i].size(), file) == data[i].size());
+	}
+
+	ok = (fclose(file) == 0) && ok;
+
+	if (ok) {
+		remove(cache.c_str()); // rename does not replace files on Windows.
+		ok = rename(temp.c_str(), cache.c_str()) == 0;
+	}
+
+	if (ok == false) {
+		fprintf(stderr, "SampleDiskCache [error] Could not write %s.\n", cache.c_str());
+		remove(temp.c_str());
+	}
+}
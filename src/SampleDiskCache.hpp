@@ -0,0 +1,133 @@
+//  SampleDiskCache.hpp :: Persistent cache of decoded samples
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#ifndef SAMPLE_DISK_CACHE_H
+#define SAMPLE_DISK_CACHE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+#include "AudioManager.hpp"
+
+/**
+ * On-disk cache of decoded samples.
+ *
+ * Each sample source (e.g. an OJM file) gets one cache file holding the
+ * raw 16-bit PCM of all of its samples, already converted to the engine
+ * sampling rate unless that is zero; streamed samples keep their
+ * compressed data as is.
+ * Cache files are read through a memory mapping, so loading
+ * a cached source costs no decoding and no resampling.
+ *
+ * Cache file layout, all integers in native byte order:
+ *
+ *     Header   header;
+ *     Record   records[header.count];
+ *     int8_t   data[];   // Interleaved PCM or compressed data of streamed
+ *                        // samples; each record points into this.
+ *
+ * Samples sharing a buffer, e.g. duplicates merged by `SampleCompactor`,
+ * are written once; their records point at the same data, and they share
+ * a buffer again once loaded.
+ *
+ * A cache file is used only if its version, engine rate and source hash
+ * match; otherwise it is ignored and overwritten by the next `save`.
+ */
+class SampleDiskCache
+{
+public:
+	static constexpr uint32_t VERSION = 2;
+
+	struct Header
+	{
+		char     magic[8];      //!< "DJPCMSC\0"
+		uint32_t version;       //!< File format version.
+		uint32_t rate;          //!< Engine sampling rate PCM data was converted to, or zero.
+		uint64_t sourceHash;    //!< Hash of the source path, size and mtime.
+		uint32_t count;         //!< Number of sample records.
+		uint32_t reserved;
+	};
+
+	enum Format : uint16_t {
+		PCM_INT16   = 0,        //!< 16-bit PCM at the record's rate.
+		ENCODED     = 1         //!< Compressed data of a streamed sample.
+	};
+
+	struct Record
+	{
+		uint32_t id;            //!< Chart sample ID.
+		uint16_t channels;      //!< Number of interleaved channels.
+		uint16_t format;        //!< Data format; see `Format`.
+		float    peak;          //!< Peak compensation multiplier.
+		uint32_t rate;          //!< Sampling rate.
+		uint64_t frames;        //!< Number of frames.
+		uint64_t offset;        //!< Offset of data from the file beginning.
+		uint64_t size;          //!< Size of data in bytes.
+		char     name[32];      //!< Sample name; null-terminated if shorter.
+	};
+
+private:
+	bool                  mEnabled;
+	std::string           mPath;    //!< Directory holding cache files.
+	unsigned long         mRate;    //!< Engine sampling rate.
+
+	//! Cache file waiting to be written.
+	struct Job
+	{
+		std::string   cache;
+		uint64_t      hash;
+		unsigned long rate;
+		SampleMap     map;
+	};
+
+	std::mutex            mMutex;
+	std::set<std::string> mPending; //!< Cache files queued or being written.
+	std::deque<Job>       mQueue;   //!< Cache files waiting to be written.
+	std::condition_variable mWake;
+	std::thread           mThread;  //!< Writes queued cache files; started by the first `save`.
+	bool                  mRunning;
+
+	SampleDiskCache();
+
+	void run();
+
+	/** Locates the cache file of a source file.
+	 *  \return false if the source file could not be inspected.
+	 */
+	bool locate(std::string const &source, std::string &cache, uint64_t &hash) const;
+
+	static void write(std::string cache, uint64_t hash, unsigned long rate, SampleMap map);
+
+public:
+	//! Writes every queued cache file before returning.
+	~SampleDiskCache();
+
+	SampleDiskCache(SampleDiskCache const &) = delete;
+	SampleDiskCache& operator=(SampleDiskCache const &) = delete;
+
+	//! @return The process-wide disk cache.
+	static SampleDiskCache& get();
+
+	void configure(bool enabled, std::string const &path, unsigned long rate);
+
+	inline bool isEnabled() const { return mEnabled; }
+
+	/** Loads every cached sample of a source file into a sample map.
+	 *  \return false if the source has no valid cache file; the sample
+	 *          map is left untouched in that case.
+	 */
+	bool load(std::string const &source, SampleMap &map);
+
+	/** Writes the samples of a source file into its cache file.
+	 *  The samples are converted and written on a background thread; the
+	 *  sample map may be changed as soon as this call returns.
+	 */
+	void save(std::string const &source, SampleMap const &map);
+};
+
+#endif
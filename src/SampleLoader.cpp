@@ -0,0 +1,182 @@
+//  SampleLoader.cpp :: Progressive chart sample loader
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#include "SampleLoader.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <map>
+
+#include "Models/EventNoteInstance.hpp"
+
+#if !( defined(_WIN32) || defined(_WIN64) )
+#include <pthread.h> // POSIX Thread naming
+#endif
+
+double SampleLoader::gLeadTime = 2.0;
+double SampleLoader::gMargin   = 1.5;
+size_t SampleLoader::gArenaSlab = 4 << 20;
+bool   SampleLoader::gHugePages = false;
+
+/** Finds the time each sample is first used at in a sequence.
+ *
+ *  Stops are ignored; ignoring them only makes samples look needed sooner.
+ */
+static std::map<unsigned int, double> find_first_uses(Sequence const &sequence, double tempo)
+{
+	std::map<unsigned int, double> first;
+
+	for (TimedNote const &note : getNoteTimes(sequence, tempo, false))
+		first.insert(std::make_pair(static_cast<unsigned>(note.audio.sampleID), note.ms));
+
+	return first;
+}
+
+SampleLoader::SampleLoader(std::shared_ptr<Chart> const &chart, AudioManager &audio)
+	: mChart    (chart)
+	, mAudio    (audio)
+	, mJobs     ()
+	, mArena    (gArenaSlab > 0 ? awe::Aarena::create(gArenaSlab, gHugePages) : nullptr)
+	, mCompactor()
+	, mNext     (0)
+	, mWeight   (0)
+	, mElapsed  (0)
+	, mStopping (false)
+{
+	Chart::SampleJobs jobs = mChart->prepare_samples();
+
+	// Cached samples have been compacted already; decoded ones may still
+	// share their buffers, and are only hashed if one might.
+	for (auto &pair : *mChart->getSampleMap()) {
+		pack(pair.second);
+		if (jobs.empty() == false)
+			mCompactor.keep(pair.second);
+	}
+
+	// Samples that needed no decoding are usable right away.
+	mAudio.insert_Samples(*mChart->getSampleMap());
+
+	auto const first = find_first_uses(*mChart->cgetSequence(), mChart->cgetInfo().tempo);
+
+	mJobs.reserve(jobs.size());
+	for (Chart::SampleJob &job : jobs)
+	{
+		auto it = first.find(job.id);
+		mJobs.push_back(Job {
+			std::move(job),
+			it == first.end() ? std::numeric_limits<double>::infinity() : it->second
+		});
+	}
+
+	std::stable_sort(mJobs.begin(), mJobs.end(),
+		[] (Job const &a, Job const &b) -> bool { return a.time < b.time; }
+	);
+
+	mThread = std::thread(&SampleLoader::run, this);
+}
+
+SampleLoader::~SampleLoader()
+{
+	mStopping = true;
+	if (mThread.joinable())
+		mThread.join();
+}
+
+void SampleLoader::run()
+{
+#if !( defined(_WIN32) || defined(_WIN64) )
+	pthread_setname_np(pthread_self(), "Sample Loader");
+#endif
+
+	auto const begin = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < mJobs.size(); i++)
+	{
+		if (mStopping) {
+			// Chart was left early; nothing is cached.
+			mChart->getSampleMap()->clear();
+			return;
+		}
+
+		Sample sample;
+		if (mJobs[i].job.decode(sample)) {
+			// Trim and merge while nothing else holds the buffer, so that
+			// trimming happens in place and duplicates are never packed.
+			if (mCompactor.compact(sample) == false) {
+				pack(sample);
+				mCompactor.keep(sample);
+			}
+
+			(*mChart->getSampleMap())[mJobs[i].job.id] = sample;
+			mAudio.insert_Sample(mJobs[i].job.id, sample);
+		}
+
+		// Release whatever the job was holding on to.
+		mJobs[i].job.decode = nullptr;
+
+		mWeight  += mJobs[i].job.weight;
+		mElapsed  = std::chrono::duration_cast<std::chrono::microseconds>(
+				std::chrono::steady_clock::now() - begin
+				).count();
+		mNext     = i + 1;
+	}
+
+	mCompactor.getReport().print(mChart->cgetInfo().name);
+	mCompactor = SampleCompactor();
+
+	mChart->finish_samples(true);
+
+	if (mArena) {
+		fprintf(stderr, "SampleLoader [info] Packed %.2f MiB of PCM into %zu slabs (%.2f MiB).\n",
+				mArena->getUsed() / 1048576.0, mArena->getSlabCount(), mArena->getCapacity() / 1048576.0
+			   );
+
+		// Samples keep the arena alive from here on.
+		mArena = nullptr;
+	}
+
+	mAudio.lock_Samples();
+
+	// The audio manager holds the samples from here on.
+	mChart->getSampleMap()->clear();
+}
+
+void SampleLoader::pack(Sample &sample)
+{
+	// Buffers shared with a cache or another chart stay where they are.
+	if (mArena && sample.isUnshared())
+		sample.pack(*mArena);
+}
+
+bool SampleLoader::ready() const
+{
+	size_t const next = mNext;
+	if (next == mJobs.size())
+		return true;
+
+	double const lead = gLeadTime * 1000.0;
+
+	// Decoding speed in weight per millisecond; unknown until a job is done.
+	double const elapsed = mElapsed / 1000.0;
+	if (next == 0 || elapsed <= 0.0)
+		return false;
+
+	double const speed = mWeight / elapsed;
+
+	// Project the completion time of every remaining job, assuming the
+	// decoder keeps its current speed, and compare it to its first use.
+	double pending = 0.0;
+	for (size_t i = next; i < mJobs.size(); i++)
+	{
+		if (mJobs[i].time < lead)
+			return false;
+
+		pending += mJobs[i].job.weight;
+
+		if (pending / speed * gMargin > mJobs[i].time)
+			return false;
+	}
+
+	return true;
+}
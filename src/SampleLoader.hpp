@@ -0,0 +1,80 @@
+//  SampleLoader.hpp :: Progressive chart sample loader
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#ifndef SAMPLE_LOADER_H
+#define SAMPLE_LOADER_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include "Models/Chart.hpp"
+#include "SampleCompactor.hpp"
+#include "libawe/Arena.hpp"
+
+/**
+ * Decodes the samples of a chart in the background, in the order they are
+ * first used on the chart timeline, and hands each to the audio manager as
+ * soon as it has been decoded.
+ *
+ * Playback may start once every sample used within the lead time has been
+ * decoded and the measured decoding speed, slowed down by a safety margin,
+ * keeps every other sample ready before its first use.
+ *
+ * Each sample is compacted before it is packed and handed over, so that
+ * the audio manager only ever sees trimmed and merged buffers. Decoded
+ * PCM data is packed into an arena owned by the chart's samples, which is
+ * freed at once when the last of them is released.
+ */
+class SampleLoader
+{
+public:
+	static double gLeadTime;    //!< Seconds of the chart to have decoded before playback.
+	static double gMargin;      //!< Factor applied to projected decoding times.
+	static size_t gArenaSlab;   //!< Arena slab size in bytes; zero disables the arena.
+	static bool   gHugePages;   //!< Back arena slabs with huge pages.
+
+private:
+	struct Job
+	{
+		Chart::SampleJob    job;
+		double              time;   //!< First use in milliseconds from the chart start.
+	};
+
+	std::shared_ptr<Chart>  mChart;
+	AudioManager          & mAudio;
+
+	std::vector<Job>        mJobs;      //!< Jobs sorted by first use.
+
+	std::shared_ptr<awe::Aarena> mArena; //!< Arena for decoded PCM data.
+	SampleCompactor         mCompactor;
+
+	std::atomic<size_t>     mNext;      //!< Index of the job being decoded.
+	std::atomic<size_t>     mWeight;    //!< Total weight of decoded jobs.
+	std::atomic<long long>  mElapsed;   //!< Microseconds spent decoding.
+	std::atomic<bool>       mStopping;
+
+	std::thread             mThread;
+
+	void run();
+	void pack(Sample &sample);
+
+public:
+	/** Starts loading the samples of a chart into an audio manager.
+	 *  The chart must have been loaded with `load_chart`.
+	 */
+	SampleLoader(std::shared_ptr<Chart> const &chart, AudioManager &audio);
+	~SampleLoader();
+
+	SampleLoader(SampleLoader const &) = delete;
+	SampleLoader& operator=(SampleLoader const &) = delete;
+
+	//! @return true once every sample has been decoded.
+	inline bool done() const { return mNext == mJobs.size(); }
+
+	//! @return true if playback can start without outrunning the decoder.
+	bool ready() const;
+};
+
+#endif
@@ -0,0 +1,141 @@
+//  StemRenderer.cpp :: Offline rendering of background notes
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#include "StemRenderer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <list>
+#include <map>
+
+#include "libawe/Filters/Mixer.hpp"
+#include "Models/Chart.hpp"
+
+bool StemRenderer::gEnabled = false;
+
+//! Most frames rendered per bus call.
+static const size_t BLOCK = 1024;
+
+Sample StemRenderer::render(Chart const &chart, SampleMap &samples, unsigned long sample_rate)
+{
+	auto const begin = std::chrono::steady_clock::now();
+
+	struct Entry
+	{
+		Sample*     sample;
+		NoteAudio   audio;
+		size_t      start;  //!< First frame of the note in the stem.
+		size_t      cut;    //!< Frame the note is cut off at by the next note on its sample.
+	};
+
+	std::vector<Entry>              entries;
+	std::map<unsigned int, size_t>  last;   //!< Index of the latest entry of each sample.
+	size_t                          length = 0;
+
+	for (TimedNote const &note : getNoteTimes(*chart.cgetSequence(), chart.cgetInfo().tempo))
+	{
+		// Notes the tracker would not play are left out as well.
+		if (covers(note.note->k) == false || isEmpty(note.audio))
+			continue;
+
+		auto it = samples.find(note.audio.sampleID);
+		if (it == samples.end() || it->second.hasData() == false || it->second.getSampleRate() == 0)
+			continue;
+
+		Sample &sample = it->second;
+		size_t const start = static_cast<size_t>(note.ms * sample_rate / 1000.0 + 0.5);
+
+		// Playing a sample again stops its previous voice; see `AudioManager::play`.
+		auto prev = last.find(note.audio.sampleID);
+		if (prev != last.end())
+			entries[prev->second].cut = start;
+
+		last[note.audio.sampleID] = entries.size();
+		entries.push_back(Entry { &sample, note.audio, start, SIZE_MAX });
+
+		length = std::max<size_t>(length, start + static_cast<size_t>(std::ceil(
+						static_cast<double>(sample.getFrameCount()) * sample_rate / sample.getSampleRate()
+						)));
+	}
+
+	if (entries.empty())
+		return Sample();
+
+	// Voices play on a bus track the way they play on a chart track. Its
+	// rack is left empty; the track the stem plays on applies its own
+	// filters at run time. The bus is run from one note start or cut to the
+	// next, so that every voice starts and stops on its exact frame.
+	Track bus(sample_rate, BLOCK, "Background stem");
+
+	struct Playing
+	{
+		Voice   voice;
+		size_t  cut;
+	};
+
+	std::list<Playing>  playing;
+	awe::AfBuffer       mix(length * 2, 0.0f);
+	size_t              next = 0;
+
+	for (size_t pos = 0; pos < length && (next < entries.size() || playing.empty() == false); )
+	{
+		for (; next < entries.size() && entries[next].start <= pos; next++)
+		{
+			Entry const &entry = entries[next];
+			playing.push_back(Playing {
+					Voice(entry.sample, &bus,
+						awe::Filter::xSinCos(entry.audio.volume, entry.audio.panning),
+						true),
+					entry.cut
+					});
+			bus.attach_source(&playing.back().voice);
+		}
+
+		size_t end = std::min(pos + BLOCK, length);
+		if (next < entries.size())
+			end = std::min(end, entries[next].start);
+
+		for (auto it = playing.begin(); it != playing.end(); )
+		{
+			if (it->voice.is_active() == false || it->cut <= pos) {
+				bus.detach_source(&it->voice);
+				it = playing.erase(it);
+			} else {
+				end = std::min(end, it->cut);
+				it++;
+			}
+		}
+
+		if (playing.empty() == false)
+		{
+			bus.setConfig(awe::ArenderConfig(sample_rate, end - pos));
+			bus.render(mix, awe::ArenderConfig(sample_rate, end - pos, pos));
+		}
+
+		pos = end;
+	}
+
+	// Store at 16 bits, folding any overshoot into the peak multiplier.
+	awe::Afloat peak = 1.0f;
+	for (awe::Afloat const &v : mix)
+		peak = std::max(peak, std::fabs(v));
+
+	auto pcm = std::make_shared<awe::AiBuffer>(mix.size());
+	for (size_t i = 0; i < mix.size(); i++)
+		(*pcm)[i] = awe::to_Aint(mix[i] / peak);
+
+	Sample stem(pcm, 2, peak, sample_rate, "Background stem");
+
+	fprintf(stderr, "StemRenderer [info] Rendered %zu notes into %.1f s of audio (%.1f MiB) in %lld ms.\n",
+			entries.size(), static_cast<double>(stem.getFrameCount()) / sample_rate,
+			stem.getMemoryUsage() / 1048576.0,
+			static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+					std::chrono::steady_clock::now() - begin
+					).count())
+		   );
+
+	return stem;
+}
@@ -0,0 +1,39 @@
+//  StemRenderer.hpp :: Offline rendering of background notes
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#ifndef STEM_RENDERER_H
+#define STEM_RENDERER_H
+
+#include "AudioManager.hpp"
+#include "Models/NoteKey.hpp"
+
+class Chart;
+
+/**
+ * Optional load stage mixing every note a chart plays on its own into a
+ * single stereo sample, the background stem.
+ *
+ * Notes on autoplay and BG lanes are fully determined by the chart, so
+ * they are rendered ahead of time through the same voice path used while
+ * playing and the stem is then played as one voice in their place.
+ */
+class StemRenderer
+{
+public:
+	static bool gEnabled;   //!< Render a background stem for every chart.
+
+	//! @return true if notes on the given key are part of the stem.
+	static inline bool covers(ENoteKey key) { return ENoteKey_isAutoPlay(key); }
+
+	/** Renders the background stem of a chart.
+	 *
+	 *  \param chart       Chart with its sequence loaded.
+	 *  \param samples     Samples of the chart; every sample used by the
+	 *                     stem must be decoded.
+	 *  \param sample_rate Sampling rate to render at.
+	 *  \return Sample holding the stem; without data if nothing is covered.
+	 */
+	static Sample render(Chart const &chart, SampleMap &samples, unsigned long sample_rate);
+};
+
+#endif
@@ -0,0 +1,162 @@
+//  Arena.cpp :: PCM data arena
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include "Arena.hpp"
+
+#if !( defined(_WIN32) || defined(_WIN64) )
+#include <sys/mman.h>
+#define AWE_ARENA_USE_MMAP
+#endif
+
+namespace awe {
+
+//! Slices are aligned to this many bytes.
+static const size_t ALIGNMENT = 64;
+static const size_t ALIGNMENT_VALUES = ALIGNMENT / sizeof(Aint);
+
+#ifdef AWE_ARENA_USE_MMAP
+//! Size and alignment of the huge pages slabs are advised to use.
+static const size_t HUGE_PAGE = 2 << 20;
+#endif
+
+//! Deleter of a slice; frees nothing, but keeps the arena alive.
+struct SliceOwner
+{
+    std::shared_ptr<Aarena> arena;
+    void operator()(const Aint*) const { }
+};
+
+Aarena::Aarena(size_t slab_bytes, bool huge_pages)
+    : mMutex    ()
+    , mSlabs    ()
+    , mSlabSize (std::max(slab_bytes, ALIGNMENT) / sizeof(Aint))
+    , mHugePages(huge_pages)
+{ }
+
+Aarena::~Aarena()
+{
+    for (Slab &slab : mSlabs) {
+#ifdef AWE_ARENA_USE_MMAP
+        if (slab.mapped) {
+            munmap(slab.data, slab.capacity * sizeof(Aint));
+            continue;
+        }
+#endif
+        ::operator delete(slab.data);
+    }
+}
+
+std::shared_ptr<Aarena> Aarena::create(size_t slab_bytes, bool huge_pages)
+{
+    return std::shared_ptr<Aarena>(new Aarena(slab_bytes, huge_pages));
+}
+
+Aarena::Slab Aarena::allocate(size_t values)
+{
+    Slab slab = { nullptr, std::max(values, mSlabSize), 0, false };
+
+#ifdef AWE_ARENA_USE_MMAP
+    // Huge pages only back whole, aligned pages; map one page more than
+    // needed and cut an aligned slab out of it.
+    size_t const align = mHugePages ? HUGE_PAGE : 0;
+    size_t const bytes = mHugePages
+        ? (slab.capacity * sizeof(Aint) + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE
+        : slab.capacity * sizeof(Aint);
+
+    void* ptr = mmap(nullptr, bytes + align,
+                     PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (ptr != MAP_FAILED) {
+        uintptr_t const base  = reinterpret_cast<uintptr_t>(ptr);
+        uintptr_t const begin = align ? (base + align - 1) / align * align : base;
+
+        if (begin > base)
+            munmap(ptr, begin - base);
+        if (base + align > begin)
+            munmap(reinterpret_cast<void*>(begin + bytes), base + align - begin);
+
+#ifdef MADV_HUGEPAGE
+        if (mHugePages)
+            madvise(reinterpret_cast<void*>(begin), bytes, MADV_HUGEPAGE);
+#endif
+        slab.data     = reinterpret_cast<Aint*>(begin);
+        slab.capacity = bytes / sizeof(Aint);
+        slab.mapped   = true;
+        return slab;
+    }
+#endif
+
+    slab.data = static_cast<Aint*>(::operator new(slab.capacity * sizeof(Aint), std::nothrow));
+    return slab;
+}
+
+std::shared_ptr<const Aint> Aarena::copy(const Aint* data, size_t length)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    // Round up so the next slice stays aligned.
+    const size_t values = (length + ALIGNMENT_VALUES - 1) / ALIGNMENT_VALUES * ALIGNMENT_VALUES;
+
+    Slab* slab = mSlabs.empty() ? nullptr : &mSlabs.back();
+
+    if (slab == nullptr || slab->capacity - slab->used < values) {
+        Slab fresh = allocate(values);
+        if (fresh.data == nullptr)
+            return nullptr;
+
+        if (fresh.capacity > mSlabSize && slab != nullptr) {
+            // Oversized data gets a slab of its own; keep filling the current one.
+            mSlabs.insert(mSlabs.end() - 1, fresh);
+            slab = &*(mSlabs.end() - 2);
+        } else {
+            mSlabs.push_back(fresh);
+            slab = &mSlabs.back();
+        }
+    }
+
+    Aint* slice = slab->data + slab->used;
+    slab->used += values;
+
+    std::copy(data, data + length, slice);
+
+    // Every slice counts its own owners and shares ownership of the arena.
+    return std::shared_ptr<const Aint>(slice, SliceOwner { shared_from_this() });
+}
+
+std::shared_ptr<Aarena> Aarena::of(const std::shared_ptr<const Aint> &data)
+{
+    const SliceOwner* owner = std::get_deleter<SliceOwner>(data);
+    return owner ? owner->arena : nullptr;
+}
+
+size_t Aarena::getCapacity()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    size_t bytes = 0;
+    for (const Slab &slab : mSlabs)
+        bytes += slab.capacity * sizeof(Aint);
+    return bytes;
+}
+
+size_t Aarena::getUsed()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    size_t bytes = 0;
+    for (const Slab &slab : mSlabs)
+        bytes += slab.used * sizeof(Aint);
+    return bytes;
+}
+
+size_t Aarena::getSlabCount()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mSlabs.size();
+}
+
+}
@@ -0,0 +1,77 @@
+//  Arena.hpp :: PCM data arena
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#ifndef AWE_ARENA_H
+#define AWE_ARENA_H
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Define.hpp"
+
+namespace awe {
+
+/** Packs PCM data of many samples into a few large slabs.
+ *
+ *  Slices handed out by an arena keep the whole arena alive; the slabs are
+ *  freed together once the last slice is released. Each slice still has
+ *  a use count of its own, which tells who holds that slice. Slabs are allocated
+ *  with `mmap` where available and may be backed by huge pages; such slabs
+ *  are aligned to and rounded up to whole 2 MiB pages.
+ */
+class Aarena : public std::enable_shared_from_this<Aarena>
+{
+private:
+    struct Slab {
+        Aint*   data;       //!< Beginning of slab.
+        size_t  capacity;   //!< Size of slab in PCM values.
+        size_t  used;       //!< PCM values handed out from slab.
+        bool    mapped;     //!< Slab was allocated with `mmap`.
+    };
+
+    std::mutex          mMutex;
+    std::vector<Slab>   mSlabs;
+    size_t              mSlabSize;  //!< Default slab size in PCM values.
+    bool                mHugePages; //!< Ask for huge pages on new slabs.
+
+    Aarena(size_t slab_bytes, bool huge_pages);
+
+    Slab allocate(size_t values);
+
+public:
+    ~Aarena();
+
+    Aarena(const Aarena&) = delete;
+    Aarena& operator=(const Aarena&) = delete;
+
+    /** Creates an arena.
+     *
+     *  \param slab_bytes Size of each slab in bytes. Data larger than this
+     *                    gets a slab of its own.
+     *  \param huge_pages Advise the kernel to back slabs with huge pages.
+     */
+    static std::shared_ptr<Aarena> create(size_t slab_bytes = 4 << 20, bool huge_pages = false);
+
+    /** Copies PCM data into a new slice of the arena.
+     *  \return nullptr if memory could not be allocated.
+     */
+    std::shared_ptr<const Aint> copy(const Aint* data, size_t length);
+
+    /** Finds the arena a slice was handed out by.
+     *  \return nullptr if the data is not a slice of an arena.
+     */
+    static std::shared_ptr<Aarena> of(const std::shared_ptr<const Aint> &data);
+
+    //! @return Total size of slabs in bytes.
+    size_t getCapacity();
+
+    //! @return Total size of slices in bytes.
+    size_t getUsed();
+
+    //! @return Number of slabs.
+    size_t getSlabCount();
+};
+
+}
+
+#endif
@@ -0,0 +1,167 @@
+//  BlockRing.hpp :: Lock-free ring of output blocks
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#ifndef AWE_BLOCK_RING_H
+#define AWE_BLOCK_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#include "Define.hpp"
+
+namespace awe {
+
+/*! Single-producer, single-consumer ring of interleaved stereo blocks.
+ *
+ *  Every block is allocated up front. The producer takes the next free
+ *  block with \ref acquire, fills it (or swaps a finished buffer of the
+ *  same size into it) and hands it over with \ref publish. The consumer
+ *  reads published blocks with \ref read, in pieces of any size, and a
+ *  block is free again once it has been read to the end.
+ *
+ *  Handing over a block is a single atomic store on either side.
+ */
+class AblockRing
+{
+private:
+    std::vector<AfBuffer>   mBlocks;
+    std::atomic<size_t>     mWrite;     //!< Blocks published so far.
+    std::atomic<size_t>     mRead;      //!< Blocks read to the end so far.
+    std::atomic<size_t>     mOffset;    //!< Frames read of the oldest published block.
+
+public:
+    AblockRing(size_t blocks = 2, size_t frames = 0)
+        : mBlocks(), mWrite(0), mRead(0), mOffset(0)
+    {
+        resize(blocks, frames);
+    }
+
+    AblockRing(const AblockRing&) = delete;
+    AblockRing& operator=(const AblockRing&) = delete;
+
+    /*! Reallocates every block and drops queued output.
+     *  \warning Neither side may use the ring meanwhile.
+     */
+    inline void resize(size_t blocks, size_t frames)
+    {
+        mBlocks.assign(std::max<size_t>(blocks, 1), AfBuffer(frames * 2, 0.0f));
+        reset();
+    }
+
+    /*! Drops queued output.
+     *  \warning Neither side may use the ring meanwhile.
+     */
+    inline void reset()
+    {
+        mWrite .store(0);
+        mRead  .store(0);
+        mOffset.store(0);
+    }
+
+    //! @return Number of blocks the ring holds.
+    inline size_t capacity() const { return mBlocks.size(); }
+
+    //! @return Number of published blocks not read to the end.
+    inline size_t size() const
+    {
+        return mWrite.load(std::memory_order_acquire) - mRead.load(std::memory_order_acquire);
+    }
+
+    //! @return Number of published frames not read yet.
+    inline size_t frames() const
+    {
+        size_t const read   = mRead  .load(std::memory_order_acquire);
+        size_t const offset = mOffset.load(std::memory_order_relaxed);
+        size_t const blocks = mWrite .load(std::memory_order_acquire) - read;
+
+        if (blocks == 0)
+            return 0;
+
+        size_t const length = mBlocks[0].size() / 2;
+        return blocks * length - std::min(offset, length);
+    }
+
+    //!\name Producer
+    //!\{
+
+    /*! \return The next block to fill, or nullptr if every block is
+     *          queued. The block holds whatever was last played from it.
+     */
+    inline AfBuffer* acquire()
+    {
+        size_t const write = mWrite.load(std::memory_order_relaxed);
+        if (write - mRead.load(std::memory_order_acquire) >= mBlocks.size())
+            return nullptr;
+
+        return &mBlocks[write % mBlocks.size()];
+    }
+
+    //! Hands the block returned by \ref acquire over to the consumer.
+    inline void publish()
+    {
+        mWrite.store(mWrite.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    //!\}
+
+    //!\name Consumer
+    //!\{
+
+    //! @return true once a block has been published since the last reset.
+    inline bool started() const
+    {
+        return mWrite.load(std::memory_order_acquire) != 0;
+    }
+
+    /*! Copies up to `frames` frames of queued output into `out`.
+     *  \return Number of frames copied.
+     */
+    inline size_t read(Afloat* out, size_t frames)
+    {
+        size_t       read   = mRead  .load(std::memory_order_relaxed);
+        size_t       offset = mOffset.load(std::memory_order_relaxed);
+        size_t const write  = mWrite .load(std::memory_order_acquire);
+        size_t       done   = 0;
+
+        while (done < frames && read != write) {
+            AfBuffer const &block  = mBlocks[read % mBlocks.size()];
+            size_t   const  length = block.size() / 2;
+            size_t   const  count  = std::min(frames - done, length - offset);
+
+            std::copy(block.begin() + offset * 2, block.begin() + (offset + count) * 2, out + done * 2);
+            done   += count;
+            offset += count;
+
+            if (offset >= length) {
+                offset = 0;
+                read  += 1;
+                mOffset.store(offset, std::memory_order_relaxed);
+                mRead  .store(read  , std::memory_order_release);
+            }
+        }
+
+        mOffset.store(offset, std::memory_order_relaxed);
+        return done;
+    }
+
+    /*! Drops every published block, as if it had been read.
+     *  \return Number of frames dropped.
+     */
+    inline size_t discard()
+    {
+        size_t const write  = mWrite .load(std::memory_order_acquire);
+        size_t const read   = mRead  .load(std::memory_order_relaxed);
+        size_t const offset = mOffset.load(std::memory_order_relaxed);
+        size_t const length = mBlocks[0].size() / 2;
+
+        mOffset.store(0, std::memory_order_relaxed);
+        mRead  .store(write, std::memory_order_release);
+        return write == read ? 0 : (write - read) * length - offset;
+    }
+
+    //!\}
+};
+
+}
+
+#endif
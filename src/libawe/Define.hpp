@@ -38,8 +38,28 @@ using AiFIFOBuffer  = AFIFObuffer<Aint  >;
 using AfFIFOBuffer  = AFIFObuffer<Afloat>;
 //!@}
 
+/*! Order of samples in a block of frames.
+ *
+ *  An interleaved block stores frames one after another; a planar block
+ *  stores one contiguous array per channel, channel after channel, so
+ *  that per-channel loops run over adjacent samples.
+ */
+enum class Alayout : uint8_t
+{
+    INTERLEAVED = 0x0,  //!< L R L R ...
+    PLANAR      = 0x1   //!< L L ... R R ...
+};
+
 #define IO_BUFFER_SIZE  16384   //!< Default file IO buffer size
 
+/** Compiles in support for keeping sample data as 32-bit floating point.
+ *  Define as 0 to leave samples at 16-bit integers regardless of what is
+ *  asked for at run time.
+ */
+#ifndef AWE_FLOAT_SAMPLES
+#define AWE_FLOAT_SAMPLES 1
+#endif
+
 //!@name Standard data type converters
 //!@{
 
@@ -113,16 +133,22 @@ struct ArenderConfig {
     /** Rendering quality. */
     Quality quality;
 
+    /** Layout of the target buffer; a planar buffer holds as many frames
+     *  per channel as its size allows. */
+    Alayout layout;
+
     /** Default constructor. */
     ArenderConfig(
         unsigned long sample_rate,
         unsigned long frame_count,
         unsigned long frame_offset = 0,
-        Quality q = Quality::DEFAULT
+        Quality q = Quality::DEFAULT,
+        Alayout l = Alayout::INTERLEAVED
     )   : sampleRate(sample_rate)
         , frameCount(frame_count)
         , frameOffset(frame_offset)
         , quality(q)
+        , layout(l)
     { }
 
 };
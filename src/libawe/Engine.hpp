@@ -5,6 +5,7 @@
 #define AWE_ENGINE_H
 
 #include "Sources/Track.hpp"
+#include "Graph.hpp"
 #include "awePortAudio.hpp"
 
 namespace awe {
@@ -20,16 +21,20 @@ class AEngine
 protected:
     APortAudio      mOutputDevice;  //!< PortAudio output device wrapper
     Source::Track   mMasterTrack;   //!< Master output track
+    ArenderGraph    mGraph;         //!< Render schedule of the master track and the tracks mixed into it
 
 public:
     AEngine(
         size_t sampling_rate = 48000,
         size_t op_frame_rate = 4096,
-        APortAudio::HostAPIType device_type = APortAudio::HostAPIType::Default
+        APortAudio::HostAPIType device_type = APortAudio::HostAPIType::Default,
+        size_t queue_blocks = 2,
+        Alayout layout = Alayout::INTERLEAVED
     ) : mOutputDevice(),
-        mMasterTrack (sampling_rate, op_frame_rate, "Output to Device")
+        mMasterTrack (sampling_rate, op_frame_rate, "Output to Device", layout),
+        mGraph       (mMasterTrack)
     {
-        if (mOutputDevice.init(sampling_rate, op_frame_rate, device_type) == false)
+        if (mOutputDevice.init(sampling_rate, op_frame_rate, device_type, queue_blocks) == false)
             throw std::runtime_error("libawe [exception] Could not initialize output device.");
     }
 
@@ -44,6 +49,28 @@ public:
      */
     inline Source::Track& getMasterTrack() { return mMasterTrack; }
 
+    /*! Retrieves the output device wrapper.
+     *  \return a reference to the output device object.
+     */
+    inline APortAudio& getOutputDevice() { return mOutputDevice; }
+
+    /*! Changes the sampling rate of the output device and the master
+     *  track. Output queued for the device is discarded.
+     *
+     *  \return false if the device could not run at the new rate; the
+     *          previous rate stays in effect.
+     */
+    virtual bool set_SampleRate(unsigned int sample_rate)
+    {
+        if (mOutputDevice.reopen(sample_rate) == false)
+            return false;
+
+        ArenderConfig config = mMasterTrack.getConfig();
+        config.sampleRate = sample_rate;
+        mMasterTrack.setConfig(config);
+        return true;
+    }
+
     /*! Pulls audio mix from master track and pushes them into the
      *  output device.
      *
@@ -59,16 +86,17 @@ public:
      */
     virtual bool update()
     {
-        if (mOutputDevice.getFIFOBuffer().size() < mMasterTrack.getOutput().size())
+        AblockRing &queue = mOutputDevice.getQueue();
+        AfBuffer   *block = queue.acquire();
+
+        if (block != nullptr && queue.frames() < mMasterTrack.getConfig().frameCount)
         {
             // Process stuff
-            mMasterTrack.pull();
-            mMasterTrack.flip();
+            mGraph.run();
 
-            // Push to output device buffer
-            mOutputDevice.getFIFOBuffer_mutex().lock();
-            mMasterTrack.push(mOutputDevice.getFIFOBuffer());
-            mOutputDevice.getFIFOBuffer_mutex().unlock();
+            // Hand the master output over to the output device
+            mMasterTrack.take_output(*block);
+            queue.publish();
 
             return true;
         } else {
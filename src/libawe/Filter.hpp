@@ -5,6 +5,7 @@
 #define AWE_FILTER_H
 
 #include "Define.hpp"
+#include "View.hpp"
 
 namespace awe {
 
@@ -26,10 +27,17 @@ public:
     //! Resets the filter to its initial state.
     virtual void reset_state() = 0;
 
-    /*! Filters input as stereo-channeled Afloat sample buffer.
+    /*! Filters a block of frames in place.
+     *  @param[in,out] view frames to filter through, in any layout
+     */
+    virtual void filter_view(Aview<Afloat, Channels> view) = 0;
+
+    /*! Filters input as an interleaved Afloat sample buffer.
      *  @param[in,out] buffer buffer to filter through
      */
-    virtual void filter_buffer(AfBuffer &buffer) = 0;
+    inline void filter_buffer(AfBuffer &buffer) {
+        filter_view(Aview<Afloat, Channels>::interleaved(buffer));
+    }
 };
 
 using AscFilter = Afilter<2>;
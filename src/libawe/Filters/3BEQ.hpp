@@ -89,23 +89,27 @@ public:
         mHG = hi_gain;
     }
 
-    inline void filter_buffer(AfBuffer &buffer) override
+    inline void filter_view(Aview<Afloat, Channels> view) override
     {
-        for(size_t i = 0; i < buffer.size(); i += 1)
+        for(Achan c = 0; c < Channels; c += 1)
         {
-            double L, M, H;
-            L = M = H = buffer[i];
+            Afloat* x = view.channel(c);
+            for(size_t i = 0; i < view.frames(); i += 1, x += view.step())
+            {
+                double L, M, H;
+                L = M = H = *x;
 
-            mLP.process(i % Channels, L);
-            mHP.process(i % Channels, H);
+                mLP.process(c, L);
+                mHP.process(c, H);
 
-            M -= (L + H);
+                M -= (L + H);
 
-            L *= mLG;
-            M *= mMG;
-            H *= mHG;
+                L *= mLG;
+                M *= mMG;
+                H *= mHG;
 
-            buffer[i] = static_cast<Afloat>(L + M + H);
+                *x = static_cast<Afloat>(L + M + H);
+            }
         }
     }
 
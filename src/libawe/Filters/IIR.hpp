@@ -63,19 +63,26 @@ namespace IIR
             process_one(mB, mA, mZ[c], v);
         }
 
-        inline void process(AfBuffer& buffer) noexcept
+        inline void process(Aview<Afloat, Channels> view) noexcept
         {
-            assert(buffer.size() % Channels == 0);
-
-            Afloat* x = buffer.data();
-            for(AfBuffer::size_type i = 0; i < buffer.size(); i++)
+            for(Achan c = 0; c < Channels; c += 1)
             {
-                double v = x[i];
-                process_one(mB, mA, mZ[i % Channels], v);
-                x[i] = static_cast< Afloat >(v);
+                Afloat* x = view.channel(c);
+                for(size_t i = 0; i < view.frames(); i++, x += view.step())
+                {
+                    double v = *x;
+                    process_one(mB, mA, mZ[c], v);
+                    *x = static_cast< Afloat >(v);
+                }
             }
         }
 
+        inline void process(AfBuffer& buffer) noexcept
+        {
+            assert(buffer.size() % Channels == 0);
+            process(Aview<Afloat, Channels>::interleaved(buffer));
+        }
+
     };
 
 };
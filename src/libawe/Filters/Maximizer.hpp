@@ -86,23 +86,21 @@ public:
     inline Afloat getCurrentGain() const { return mGain; }
     inline Afloat getPeakSample () const { return mPeakSample; }
 
-    /** Performs maximization on the audio buffer.
-     *  \param buffer The audio buffer to filter.
+    /** Performs maximization on a block of audio.
+     *  \param view The frames to filter.
      */
-    void filter_buffer(AfBuffer &buffer) override
+    void filter_view(Aview<Afloat, Channels> view) override
     {
         mPeakSample = 0.0f;
 
-        Afloat* frame = buffer.data();
-
-        for(size_t i = 0; i < buffer.size(); i += Channels, frame += Channels)
+        for(size_t i = 0; i < view.frames(); i += 1)
         {
             Afloat  framePeak = 0.0f;
 
             //  Get peak value in frame.
             for(Achan c = 0; c < Channels; c += 1) {
-                frame[c] *= mBoost;
-                framePeak = std::max(framePeak, std::abs(frame[c]));
+                view.at(i, c) *= mBoost;
+                framePeak = std::max(framePeak, std::abs(view.at(i, c)));
             }
 
             //  Get peak value on this filter run.
@@ -124,7 +122,7 @@ public:
 
             //  Apply limiter.
             for(Achan c = 0; c < Channels; c += 1)
-                frame[c] *= mCeiling / mGain;
+                view.at(i, c) *= mCeiling / mGain;
 
             //  Apply limiter release.
             if (mGain > 1.0f / mThreshold)
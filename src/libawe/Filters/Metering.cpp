@@ -11,32 +11,19 @@ AscMetering::AscMetering(Afloat freq, Afloat decay)
     , mDecay(decay)
     , mPeak ({0.0f, 0.0f})
     , mRMS  ({0.0f, 0.0f})
-    , mdOCI ({int16_t{0}, int16_t{0}})
+    , mdOCI ()
     , mdRMS ({0.0f, 0.0f})
 {
 
 }
 
-void AscMetering::filter_buffer(AfBuffer &buffer)
+void AscMetering::filter_view(AscView view)
 {
-    mPeak *= 0;
-    mRMS  *= 0;
+    Asfloatf mSum;
 
-    Asfloatf mSum({0.0f, 0.0f});
+    measure(view, mPeak, mSum);
 
-    for(size_t i = 0; i < buffer.size() / 2; i++)
-    {
-        Asfloatf m = Asfloatf::from_buffer(buffer, i);
-        m.abs();
-
-        mPeak[0] = std::max(mPeak[0], m[0]);
-        mPeak[1] = std::max(mPeak[1], m[1]);
-
-        mSum[0] += m[0] * m[0];
-        mSum[1] += m[1] * m[1];
-    }
-
-    mSum /= buffer.size() / 2;
+    mSum /= view.frames();
 
     mRMS[0] = sqrt(mSum[0]);
     mRMS[1] = sqrt(mSum[1]);
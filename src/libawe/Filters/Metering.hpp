@@ -44,7 +44,7 @@ public:
         mdOCI  *= 0;
         mdRMS  *= 0;
     }
-    virtual void filter_buffer(AfBuffer &buffer) override;
+    virtual void filter_view(AscView view) override;
 };
 }
 }
@@ -6,6 +6,7 @@
 
 #include "../Filter.hpp"
 #include "../Frame.hpp"
+#include "../View.hpp"
 
 namespace awe {
 namespace Filter {
@@ -65,21 +66,13 @@ public:
 
     inline void reset_state() override { reset(vol, pan); }
 
-    void filter_buffer(AfBuffer &buffer) override
+    void filter_view(Aview<Afloat, Channels> view) override
     {
-        if (Channels == 1) {
-            std::for_each(
-                    buffer.begin(), buffer.end(),
-                    [this](Afloat &value) { value *= vol; }
-                    );
-        } else {
-            for(AfBuffer::size_type i = 0; i < buffer.size() / Channels; i++)
-            {
-                Asfloatf frame = Asfloatf::from_buffer(buffer, i);
-                frame *= chgain;
-                frame.to_buffer(buffer, i);
-            }
-        }
+        Aframe<Afloat, Channels> gain;
+        for (Achan c = 0; c < Channels; c += 1)
+            gain[c] = (Channels == 1) ? vol : chgain[c];
+
+        scale(view, gain);
     }
 
     //!@name Apply-on-sample operations
@@ -28,9 +28,9 @@ public:
             filter->reset_state();
     }
 
-    inline void filter_buffer(AfBuffer &buffer) override {
+    inline void filter_view(Aview<Afloat, Channels> view) override {
         for(filter_type* filter : filters)
-            filter->filter_buffer(buffer);
+            filter->filter_view(view);
     }
 
     inline void attach_filter(filter_type* filter) { filters.push_back(filter); }
@@ -9,6 +9,21 @@
 #include <algorithm>
 #include <array>
 
+/** Builds the SSE2 version of stereo Afloat frames and block kernels.
+ *  Define as 0 to fall back to plain per-channel code.
+ */
+#ifndef AWE_SSE2
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AWE_SSE2 1
+#else
+#define AWE_SSE2 0
+#endif
+#endif
+
+#if AWE_SSE2
+#include <emmintrin.h>
+#endif
+
 namespace awe
 {
 
@@ -34,7 +49,6 @@ struct Aframe {
     }
 
     Aframe(const container_type&  _data) : data(_data) {}
-    Aframe(const container_type && _data) : data(_data) {}
 
     T& operator[](const Achan& pos) {
         return data[pos];
@@ -200,6 +214,127 @@ struct Aframe {
     }
 };
 
+/*! Stereo Afloat frame.
+ *
+ *  Same interface as any other frame, but both channels are worked on at
+ *  once in the low half of an SSE2 register where available. Frames of
+ *  other sizes cannot be mixed in; every stereo frame in libawe is one.
+ */
+template<>
+struct Aframe< Afloat, 2 > {
+    using container_type = std::array< Afloat, 2 >;
+    using value_type     = Afloat;
+
+    alignas(8) container_type data;
+
+    Aframe() : data() { }
+    Aframe(const Afloat* _data, Achan _size = 2) : data() {
+        std::copy(_data, _data + std::min<Achan>(_size, 2), data.begin());
+    }
+
+    Aframe(const container_type& _data) : data(_data) {}
+
+    Afloat& operator[](const Achan& pos) {
+        return data[pos];
+    }
+
+    static Aframe from_buffer(AfBuffer const& buffer, size_t frame) {
+        assert(buffer.size() / 2 > frame);
+        Aframe f;
+#if AWE_SSE2
+        store(f.data.data(), load(buffer.data() + frame * 2));
+#else
+        f.data[0] = buffer[frame * 2    ];
+        f.data[1] = buffer[frame * 2 + 1];
+#endif
+        return f;
+    }
+
+    void to_buffer(AfBuffer& buffer, size_t frame) const {
+        assert(buffer.size() / 2 > frame);
+#if AWE_SSE2
+        store(buffer.data() + frame * 2, load(data.data()));
+#else
+        buffer[frame * 2    ] = data[0];
+        buffer[frame * 2 + 1] = data[1];
+#endif
+    }
+
+    /* ARITHMETIC */
+#if AWE_SSE2
+    void operator+= (const Afloat& v) { store(data.data(), _mm_add_ps(load(data.data()), _mm_set1_ps(v))); }
+    void operator-= (const Afloat& v) { store(data.data(), _mm_sub_ps(load(data.data()), _mm_set1_ps(v))); }
+    void operator*= (const Afloat& v) { store(data.data(), _mm_mul_ps(load(data.data()), _mm_set1_ps(v))); }
+    void operator/= (const Afloat& v) { store(data.data(), _mm_div_ps(load(data.data()), _mm_set1_ps(v))); }
+
+    Aframe operator+ (Aframe const& v) const { Aframe f; store(f.data.data(), _mm_add_ps(load(data.data()), load(v.data.data()))); return f; }
+    Aframe operator- (Aframe const& v) const { Aframe f; store(f.data.data(), _mm_sub_ps(load(data.data()), load(v.data.data()))); return f; }
+    Aframe operator* (Aframe const& v) const { Aframe f; store(f.data.data(), _mm_mul_ps(load(data.data()), load(v.data.data()))); return f; }
+    Aframe operator/ (Aframe const& v) const { Aframe f; store(f.data.data(), _mm_div_ps(load(data.data()), load(v.data.data()))); return f; }
+
+    void operator+= (container_type const& v) { store(data.data(), _mm_add_ps(load(data.data()), load(v.data()))); }
+    void operator-= (container_type const& v) { store(data.data(), _mm_sub_ps(load(data.data()), load(v.data()))); }
+    void operator*= (container_type const& v) { store(data.data(), _mm_mul_ps(load(data.data()), load(v.data()))); }
+    void operator/= (container_type const& v) { store(data.data(), _mm_div_ps(load(data.data()), load(v.data()))); }
+#else
+    void operator+= (const Afloat& v) { data[0] += v; data[1] += v; }
+    void operator-= (const Afloat& v) { data[0] -= v; data[1] -= v; }
+    void operator*= (const Afloat& v) { data[0] *= v; data[1] *= v; }
+    void operator/= (const Afloat& v) { data[0] /= v; data[1] /= v; }
+
+    Aframe operator+ (Aframe const& v) const { return container_type {{ data[0] + v.data[0], data[1] + v.data[1] }}; }
+    Aframe operator- (Aframe const& v) const { return container_type {{ data[0] - v.data[0], data[1] - v.data[1] }}; }
+    Aframe operator* (Aframe const& v) const { return container_type {{ data[0] * v.data[0], data[1] * v.data[1] }}; }
+    Aframe operator/ (Aframe const& v) const { return container_type {{ data[0] / v.data[0], data[1] / v.data[1] }}; }
+
+    void operator+= (container_type const& v) { data[0] += v[0]; data[1] += v[1]; }
+    void operator-= (container_type const& v) { data[0] -= v[0]; data[1] -= v[1]; }
+    void operator*= (container_type const& v) { data[0] *= v[0]; data[1] *= v[1]; }
+    void operator/= (container_type const& v) { data[0] /= v[0]; data[1] /= v[1]; }
+#endif
+
+    void operator+= (Aframe const& v) { *this += v.data; }
+    void operator-= (Aframe const& v) { *this -= v.data; }
+    void operator*= (Aframe const& v) { *this *= v.data; }
+    void operator/= (Aframe const& v) { *this /= v.data; }
+
+    /* ALGORITHMS */
+    template <typename Function>
+    void operator()(Function F) {
+        F(data[0]);
+        F(data[1]);
+    }
+
+    void abs() {
+#if AWE_SSE2
+        store(data.data(), _mm_andnot_ps(_mm_set1_ps(-0.0f), load(data.data())));
+#else
+        data[0] = std::fabs(data[0]);
+        data[1] = std::fabs(data[1]);
+#endif
+    }
+
+    Afloat absmax() const {
+        return std::max<>(std::fabs(data[0]), std::fabs(data[1]));
+    }
+
+    Afloat absmin() const {
+        return std::min<>(std::fabs(data[0]), std::fabs(data[1]));
+    }
+
+#if AWE_SSE2
+    //! Loads two samples into the low half of a register; the high half is zero.
+    static inline __m128 load(Afloat const* p) {
+        return _mm_castpd_ps(_mm_load_sd(reinterpret_cast<double const*>(p)));
+    }
+
+    //! Stores the low half of a register as two samples.
+    static inline void store(Afloat* p, __m128 v) {
+        _mm_store_sd(reinterpret_cast<double*>(p), _mm_castps_pd(v));
+    }
+#endif
+};
+
 //!@name Standard libawe frame types
 //!@{
 typedef Aframe<Aint  , 2> Asintf;                           //!< a stereo Aint frame
@@ -0,0 +1,149 @@
+//  Graph.cpp :: Flattened render schedule of nested tracks
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#include "Graph.hpp"
+#include "Log.hpp"
+#include "Profile.hpp"
+
+namespace awe {
+
+//  Nesting depth beyond which a track is taken to be part of a cycle.
+static const size_t kMaxDepth = 64;
+
+ArenderGraph::ArenderGraph(Source::Track &root)
+    : mRoot  (root)
+    , mNodes ()
+    , mLeaves()
+{ }
+
+void ArenderGraph::compile()
+{
+    mNodes .clear();
+    mLeaves.clear();
+
+    compile(mRoot, 0);
+}
+
+size_t ArenderGraph::compile(Source::Track &track, size_t depth)
+{
+    for (Node const &node : mNodes) {
+        if (node.track == &track) {
+            AWE_LOG(WARN, "Graph", "A track is mixed into more than one track; it is mixed into the first only.");
+            return ROOT;
+        }
+    }
+
+    if (depth > kMaxDepth) {
+        AWE_LOG(ERROR, "Graph", "Tracks are nested too deep; they may form a cycle.");
+        return ROOT;
+    }
+
+    // Read the version first; a list published meanwhile makes it stale.
+    uint64_t const version = track.getVersion();
+    Source::Track::SourceGuard sources(track);
+
+    std::vector<size_t> children;
+    for (Asource* src : *sources) {
+        Source::Track* const child = dynamic_cast<Source::Track*>(src);
+        if (child != nullptr)
+            children.push_back(compile(*child, depth + 1));
+    }
+
+    Node node;
+    node.track   = &track;
+    node.parent  = ROOT;
+    node.first   = mLeaves.size();
+    node.version = version;
+    node.epoch   = 0;
+    node.skip    = false;
+
+    for (Asource* src : *sources)
+        if (dynamic_cast<Source::Track*>(src) == nullptr)
+            mLeaves.push_back(src);
+
+    node.last = mLeaves.size();
+    mNodes.push_back(node);
+
+    for (size_t child : children)
+        if (child != ROOT)
+            mNodes[child].parent = mNodes.size() - 1;
+
+    return mNodes.size() - 1;
+}
+
+bool ArenderGraph::hold()
+{
+    if (mNodes.empty())
+        return false;
+
+    // A child is only touched once its parent is held with the list it
+    // was compiled from, which keeps the child from being freed.
+    for (size_t i = mNodes.size(); i-- > 0; ) {
+        Node &node = mNodes[i];
+        node.epoch = node.track->enter();
+
+        // Read the version after counting; see `Track::synchronize`.
+        if (node.track->getVersion() != node.version) {
+            release(i);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void ArenderGraph::release(size_t first)
+{
+    for (size_t i = first; i < mNodes.size(); i++)
+        mNodes[i].track->leave(mNodes[i].epoch);
+}
+
+void ArenderGraph::run()
+{
+    while (hold() == false)
+        compile();
+
+    // Work out, root first, which tracks their parent would not render.
+    for (size_t i = mNodes.size(); i-- > 0; ) {
+        Node &node = mNodes[i];
+        if (node.parent == ROOT) {
+            node.skip = false;
+            continue;
+        }
+
+        Node const &parent = mNodes[node.parent];
+        node.skip = parent.skip
+                 || parent.track->mPconfig.quality == ArenderConfig::Quality::SKIP
+                 || node.track->is_active() == false;
+    }
+
+    for (Node const &node : mNodes) {
+        if (node.skip)
+            continue;
+
+        Source::Track &track = *node.track;
+
+        {
+            AWE_PROFILE_STAGE(TRACK_PULL);
+            for (size_t i = node.first; i < node.last; i++)
+                track.fpull(mLeaves[i]);
+        }
+
+        {
+            Source::Track::MutexLockGuard o_lock(track.mOmutex);
+            track.fflip();
+            track.ffilter();
+        }
+
+        if (node.parent == ROOT)
+            continue;
+
+        Source::Track &parent = *mNodes[node.parent].track;
+        if (parent.mPconfig.quality != ArenderConfig::Quality::MUTE)
+            track.fmix(parent.mPbuffer, parent.mPconfig);
+    }
+
+    release();
+}
+
+}
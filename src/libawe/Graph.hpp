@@ -0,0 +1,99 @@
+//  Graph.hpp :: Flattened render schedule of nested tracks
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#ifndef AWE_GRAPH_H
+#define AWE_GRAPH_H
+
+#include <cstdint>
+#include <vector>
+#include "Define.hpp"
+#include "Source.hpp"
+#include "Sources/Track.hpp"
+
+namespace awe {
+
+/*! Render schedule of a tree of nested tracks.
+ *
+ *  Rendering a track that has tracks among its sources normally recurses
+ *  through `Track::render`, locking both mutexes of every track on the
+ *  way. A render graph instead walks the tree once and lays it out as a
+ *  flat list of tracks, children before their parents, each with the
+ *  range of its other sources in one shared array. A block then runs
+ *  through that list in one pass, mixing each track straight into its
+ *  parent's pool buffer.
+ *
+ *  The schedule is compiled again before a block only when the source
+ *  list of one of its tracks has changed. Each block counts as a reader
+ *  of every track in it, as a `Track::SourceGuard` does, so that sources
+ *  detached meanwhile are not freed before the block is done with them.
+ *
+ *  \warning A graph owns the pool side of every track in it while it
+ *           runs: only one thread may run it, and it must not run
+ *           alongside locked pool calls (`pull`, `setConfig`, `render`)
+ *           on those tracks. The output mutex of each track is still
+ *           taken while its output is flipped and filtered.
+ */
+class ArenderGraph
+{
+private:
+    static const size_t ROOT = SIZE_MAX;    //!< Parent index of the root track.
+
+    struct Node
+    {
+        Source::Track*  track;
+        size_t          parent;     //!< Index of the parent node, or `ROOT`.
+        size_t          first;      //!< First of this track's other sources in `mLeaves`.
+        size_t          last;       //!< One past its last.
+        uint64_t        version;    //!< Source list version compiled from.
+        unsigned        epoch;      //!< Reader epoch the current block is counted in.
+        bool            skip;       //!< Not rendered in the current block.
+    };
+
+    Source::Track&          mRoot;
+    std::vector<Node>       mNodes;     //!< Tracks, children before their parents; root last.
+    std::vector<Asource*>   mLeaves;    //!< Sources that are not tracks, grouped by track.
+
+    /*! Adds a track and, before it, every track below it.
+     *  \return Index of its node, or `ROOT` if it was left out.
+     */
+    size_t compile(Source::Track &track, size_t depth);
+
+    /*! Counts the current block as a reader of every track in the
+     *  schedule, root first.
+     *  \return false, holding nothing, if a track's source list changed
+     *          since compiling.
+     */
+    bool hold();
+
+    //! Stops counting the current block as a reader of tracks from `first` on.
+    void release(size_t first = 0);
+
+public:
+    explicit ArenderGraph(Source::Track &root);
+
+    ArenderGraph(const ArenderGraph&) = delete;
+    ArenderGraph& operator=(const ArenderGraph&) = delete;
+
+    //! Lays out the schedule again from the root track.
+    void compile();
+
+    /*! Renders one block into the output buffer of the root track.
+     *  Sources rendered into a track's pool since the previous block,
+     *  e.g. through `pull`, are mixed in as well.
+     */
+    void run();
+
+    /*! Renders a source into the pool buffer of a track, as
+     *  `Track::pull(src)` does, without locking.
+     */
+    static inline void pull(Source::Track &track, Asource *src) { track.fpull(src); }
+
+    //! @return Number of tracks in the schedule.
+    inline size_t count_tracks() const { return mNodes.size(); }
+
+    inline Source::Track& getRoot() { return mRoot; }
+};
+
+}
+
+#endif
@@ -0,0 +1,201 @@
+//  Log.cpp :: Real-time safe logging
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#include <chrono>
+#include <cstring>
+#include <string>
+#include "Log.hpp"
+
+namespace awe {
+
+//! Number of records the ring holds; a power of two.
+static const size_t CAPACITY = 1024;
+
+//! Time the drain thread sleeps between passes.
+static const std::chrono::milliseconds DRAIN_PERIOD(20);
+
+static const char* level_name(AlogLevel level)
+{
+    switch (level) {
+        case AlogLevel::DEBUG:  return "debug";
+        case AlogLevel::INFO:   return "info";
+        case AlogLevel::WARN:   return "warn";
+        case AlogLevel::ERROR:  return "error";
+    }
+    return "?";
+}
+
+Alog::Alog(size_t capacity, FILE* output)
+    : mSlots    (capacity)
+    , mMask     (capacity - 1)
+    , mHead     (0)
+    , mTail     (0)
+    , mDropped  (0)
+    , mReported (0)
+    , mOutput   (output)
+    , mRunning  (true)
+    , mThread   ()
+{
+    for (size_t i = 0; i < capacity; i++)
+        mSlots[i].sequence.store(i, std::memory_order_relaxed);
+
+    mThread = std::thread(&Alog::run, this);
+}
+
+Alog::~Alog()
+{
+    mRunning.store(false);
+    if (mThread.joinable())
+        mThread.join();
+
+    drain();
+}
+
+Alog& Alog::get()
+{
+    static Alog log(CAPACITY, stderr);
+    return log;
+}
+
+bool Alog::push(AlogRecord const &record)
+{
+    // Bounded multi-producer queue; each slot's sequence tells whether it
+    // is free for the given position or still holds an unread record.
+    size_t pos = mHead.load(std::memory_order_relaxed);
+    Slot*  slot;
+
+    for (;;) {
+        slot = &mSlots[pos & mMask];
+        size_t const seq  = slot->sequence.load(std::memory_order_acquire);
+        intptr_t const diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+        if (diff == 0) {
+            if (mHead.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            mDropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = mHead.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->record = record;
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+size_t Alog::drain()
+{
+    size_t count = 0;
+
+    for (;;) {
+        Slot &slot = mSlots[mTail & mMask];
+        if (slot.sequence.load(std::memory_order_acquire) != mTail + 1)
+            break;
+
+        write(slot.record);
+        slot.sequence.store(mTail + mMask + 1, std::memory_order_release);
+        mTail++;
+        count++;
+    }
+
+    size_t const dropped = mDropped.load(std::memory_order_relaxed);
+    if (dropped != mReported) {
+        fprintf(mOutput, "libawe [warn] %zu log record(s) dropped; log ring full.\n", dropped - mReported);
+        mReported = dropped;
+    }
+
+    if (count != 0)
+        fflush(mOutput);
+
+    return count;
+}
+
+void Alog::run()
+{
+    while (mRunning.load()) {
+        drain();
+        std::this_thread::sleep_for(DRAIN_PERIOD);
+    }
+}
+
+void Alog::write(AlogRecord const &record)
+{
+    // Formats one conversion at a time; length modifiers in the format are
+    // replaced by those matching the stored argument type.
+    std::string line;
+    line.reserve(128);
+
+    char   buffer[256];
+    size_t arg = 0;
+
+    for (const char* p = record.format; *p != '\0'; p++) {
+        if (*p != '%') {
+            line += *p;
+            continue;
+        }
+
+        if (p[1] == '%') {
+            line += '%';
+            p++;
+            continue;
+        }
+
+        std::string spec = "%";
+        const char* q = p + 1;
+        while (*q != '\0' && strchr("-+ #0123456789.", *q) != nullptr)
+            spec += *q++;
+        while (*q != '\0' && strchr("hlLqjzt", *q) != nullptr)
+            q++;
+
+        if (*q == '\0' || arg >= record.count) {
+            line.append(p, q);
+            p = q - 1;
+            if (*q == '\0') break;
+            continue;
+        }
+
+        char const conv = *q;
+        AlogRecord::Arg const &a = record.args[arg++];
+
+        buffer[0] = '\0';
+        if (conv == 'c' && a.type != 's') {
+            snprintf(buffer, sizeof(buffer), (spec + 'c').c_str(), static_cast<int>(a.type == 'd' ? a.d : a.i));
+        } else {
+            bool const integer  = strchr("diuxXo", conv) != nullptr;
+            bool const floating = strchr("eEfFgGaA", conv) != nullptr;
+
+            switch (a.type) {
+                case 'i':
+                    if (floating)
+                        snprintf(buffer, sizeof(buffer), (spec + conv).c_str(), static_cast<double>(a.i));
+                    else
+                        snprintf(buffer, sizeof(buffer), (spec + "ll" + (integer ? conv : 'd')).c_str(), static_cast<long long>(a.i));
+                    break;
+                case 'u':
+                    if (floating)
+                        snprintf(buffer, sizeof(buffer), (spec + conv).c_str(), static_cast<double>(a.u));
+                    else
+                        snprintf(buffer, sizeof(buffer), (spec + "ll" + (integer ? conv : 'u')).c_str(), static_cast<unsigned long long>(a.u));
+                    break;
+                case 'd':
+                    if (integer)
+                        snprintf(buffer, sizeof(buffer), (spec + "lld").c_str(), static_cast<long long>(a.d));
+                    else
+                        snprintf(buffer, sizeof(buffer), (spec + (floating ? conv : 'g')).c_str(), a.d);
+                    break;
+                case 's':
+                    snprintf(buffer, sizeof(buffer), (spec + 's').c_str(), a.s != nullptr ? a.s : "(null)");
+                    break;
+            }
+        }
+
+        line += buffer;
+        p = q;
+    }
+
+    fprintf(mOutput, "%s [%s] %s\n", record.source, level_name(record.level), line.c_str());
+}
+
+}
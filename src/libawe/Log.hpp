@@ -0,0 +1,155 @@
+//  Log.hpp :: Real-time safe logging
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#ifndef AWE_LOG_H
+#define AWE_LOG_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace awe {
+
+//! Severity of a log record.
+enum class AlogLevel : uint8_t {
+    DEBUG = 0,
+    INFO  = 1,
+    WARN  = 2,
+    ERROR = 3
+};
+
+/** Records below this level are compiled out.
+ *  Defaults to `INFO`; define as 0 to keep debug records.
+ */
+#ifndef AWE_LOG_LEVEL
+#define AWE_LOG_LEVEL 1
+#endif
+
+/** Fixed-size log record.
+ *
+ *  The source and format strings are not copied and must outlive the
+ *  record, i.e. be string literals. So must string arguments.
+ */
+struct AlogRecord
+{
+    enum { MAX_ARGS = 6 };
+
+    struct Arg {
+        union {
+            int64_t     i;
+            uint64_t    u;
+            double      d;
+            const char* s;
+        };
+        char type;  //!< 'i', 'u', 'd' or 's'.
+    };
+
+    const char* source;         //!< Component name, e.g. "PortAudio".
+    const char* format;         //!< printf-style format string.
+    AlogLevel   level;
+    uint8_t     count;          //!< Number of arguments used.
+    Arg         args[MAX_ARGS];
+};
+
+/** Logger taking records from any thread without locking or allocating.
+ *
+ *  Records are put into a preallocated ring and a background thread
+ *  formats and writes them out. Records logged while the ring is full are
+ *  dropped and counted.
+ */
+class Alog
+{
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        AlogRecord          record;
+    };
+
+    std::vector<Slot>   mSlots;
+    size_t              mMask;
+    std::atomic<size_t> mHead;      //!< Next slot to write to.
+    size_t              mTail;      //!< Next slot to read from; drain thread only.
+    std::atomic<size_t> mDropped;
+    size_t              mReported;  //!< Dropped records already reported.
+
+    FILE*               mOutput;
+    std::atomic<bool>   mRunning;
+    std::thread         mThread;
+
+    Alog(size_t capacity, FILE* output);
+
+    void run();
+    void write(AlogRecord const &record);
+
+    static inline void pack(AlogRecord::Arg &arg, const char* v) { arg.s = v; arg.type = 's'; }
+    static inline void pack(AlogRecord::Arg &arg, double v) { arg.d = v; arg.type = 'd'; }
+
+    template<typename T>
+    static inline typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+    pack(AlogRecord::Arg &arg, T v)
+    {
+        if (std::is_signed<T>::value) {
+            arg.i = static_cast<int64_t>(v); arg.type = 'i';
+        } else {
+            arg.u = static_cast<uint64_t>(v); arg.type = 'u';
+        }
+    }
+
+    static inline void pack(AlogRecord&, size_t) { }
+
+    template<typename T, typename... Args>
+    static inline void pack(AlogRecord &record, size_t n, T v, Args... args)
+    {
+        static_assert(sizeof...(Args) < AlogRecord::MAX_ARGS, "Too many log arguments.");
+        pack(record.args[n], v);
+        pack(record, n + 1, args...);
+    }
+
+public:
+    ~Alog();
+
+    Alog(const Alog&) = delete;
+    Alog& operator=(const Alog&) = delete;
+
+    //! @return Logger shared by the whole process; started on first use.
+    static Alog& get();
+
+    /** Queues a record. Never blocks.
+     *  \return false if the ring was full and the record was dropped.
+     */
+    bool push(AlogRecord const &record);
+
+    template<typename... Args>
+    inline bool log(AlogLevel level, const char* source, const char* format, Args... args)
+    {
+        AlogRecord record;
+        record.source = source;
+        record.format = format;
+        record.level  = level;
+        record.count  = sizeof...(Args);
+        pack(record, 0, args...);
+        return push(record);
+    }
+
+    //! Writes out every queued record. Called by the drain thread.
+    size_t drain();
+
+    //! @return Number of records dropped so far.
+    inline size_t getDropped() const { return mDropped.load(std::memory_order_relaxed); }
+};
+
+}
+
+/** Logs a record at the given level, e.g.
+ *  `AWE_LOG(WARN, "PortAudio", "%u underflows.", count);`
+ *  Compiles to nothing below `AWE_LOG_LEVEL`.
+ */
+#define AWE_LOG(level, ...) do { \
+    if (static_cast<int>(awe::AlogLevel::level) >= AWE_LOG_LEVEL) \
+        awe::Alog::get().log(awe::AlogLevel::level, __VA_ARGS__); \
+} while (0)
+
+#endif
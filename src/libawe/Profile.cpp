@@ -0,0 +1,130 @@
+//  Profile.cpp :: Per-stage DSP timing
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#include <algorithm>
+#include "Log.hpp"
+#include "Profile.hpp"
+
+namespace awe {
+
+size_t Ahistogram::bucket(uint64_t ns)
+{
+    if (ns < SUB)
+        return static_cast<size_t>(ns);
+
+    size_t e = 63;
+    while ((ns >> e) == 0)
+        e--;
+
+    return (e - SUB_BITS + 1) * SUB + ((ns >> (e - SUB_BITS)) & (SUB - 1));
+}
+
+uint64_t Ahistogram::lower(size_t bucket)
+{
+    if (bucket < SUB)
+        return bucket;
+
+    size_t const e   = bucket / SUB + SUB_BITS - 1;
+    size_t const sub = bucket % SUB;
+    return static_cast<uint64_t>(SUB + sub) << (e - SUB_BITS);
+}
+
+void Ahistogram::record(uint64_t ns)
+{
+    mBuckets[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t v = mMin.load(std::memory_order_relaxed);
+    while (ns < v && !mMin.compare_exchange_weak(v, ns, std::memory_order_relaxed));
+
+    v = mMax.load(std::memory_order_relaxed);
+    while (ns > v && !mMax.compare_exchange_weak(v, ns, std::memory_order_relaxed));
+}
+
+void Ahistogram::reset()
+{
+    for (std::atomic<uint64_t> &b : mBuckets)
+        b.store(0, std::memory_order_relaxed);
+
+    mMin  .store(UINT64_MAX, std::memory_order_relaxed);
+    mMax  .store(0, std::memory_order_relaxed);
+}
+
+AstageSummary Ahistogram::summary() const
+{
+    AstageSummary s = { 0, 0, 0, 0, 0, 0, 0 };
+
+    // Buckets are read one at a time; take the count from them so that
+    // percentiles stay consistent with concurrent records.
+    std::array<uint64_t, BUCKETS> counts;
+    for (size_t i = 0; i < BUCKETS; i++) {
+        counts[i] = mBuckets[i].load(std::memory_order_relaxed);
+        s.count  += counts[i];
+    }
+
+    if (s.count == 0)
+        return s;
+
+    s.min = static_cast<double>(mMin.load(std::memory_order_relaxed));
+    s.max = static_cast<double>(mMax.load(std::memory_order_relaxed));
+
+    double const  ranks[] = { 0.50, 0.90, 0.99, 0.999 };
+    double* const out  [] = { &s.p50, &s.p90, &s.p99, &s.p999 };
+
+    size_t   r    = 0;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS && r < 4; i++) {
+        seen += counts[i];
+        while (r < 4 && seen >= ranks[r] * s.count) {
+            // Middle of the bucket, within the exact extremes.
+            double const mid = (lower(i) + (i + 1 < BUCKETS ? lower(i + 1) : lower(i))) / 2.0;
+            *out[r++] = std::min(s.max, std::max(s.min, mid));
+        }
+    }
+
+    return s;
+}
+
+Aprofiler& Aprofiler::get()
+{
+    static Aprofiler profiler;
+    return profiler;
+}
+
+const char* Aprofiler::name(Astage stage)
+{
+    switch (stage) {
+        case Astage::VOICE_RENDER:  return "Voice render";
+        case Astage::TRACK_PULL:    return "Track pull";
+        case Astage::RACK_FILTER:   return "Rack filter";
+        case Astage::OUTPUT_PUSH:   return "Output push";
+        case Astage::BLOCK:         return "Block";
+        case Astage::COUNT:         break;
+    }
+    return "?";
+}
+
+void Aprofiler::reset()
+{
+    for (Ahistogram &h : mStages)
+        h.reset();
+}
+
+void Aprofiler::dump() const
+{
+    double const deadline = static_cast<double>(getDeadline());
+
+    AWE_LOG(INFO, "Profile", "Stage timings in us; block deadline %.0f us.", deadline / 1000.0);
+
+    for (size_t i = 0; i < mStages.size(); i++) {
+        AstageSummary const s = mStages[i].summary();
+        if (s.count == 0)
+            continue;
+
+        AWE_LOG(INFO, "Profile", "%-12s min %7.1f  p50 %7.1f  p99 %7.1f  max %7.1f  (max %5.1f%% of deadline)",
+                name(static_cast<Astage>(i)),
+                s.min / 1000.0, s.p50 / 1000.0, s.p99 / 1000.0, s.max / 1000.0,
+                deadline > 0 ? s.max * 100.0 / deadline : 0.0);
+    }
+}
+
+}
@@ -0,0 +1,166 @@
+//  Profile.hpp :: Per-stage DSP timing
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#ifndef AWE_PROFILE_H
+#define AWE_PROFILE_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/** Set to 0 to compile out every stage timer. */
+#ifndef AWE_PROFILE
+#define AWE_PROFILE 1
+#endif
+
+namespace awe {
+
+//! Stages of the render path timed by the profiler. Stages may nest.
+enum class Astage : uint8_t {
+    VOICE_RENDER,   //!< One voice rendered into its track.
+    TRACK_PULL,     //!< A track pulling all of its sources.
+    RACK_FILTER,    //!< A track running its filter rack.
+    OUTPUT_PUSH,    //!< Master output pushed to the device queue.
+    BLOCK,          //!< One whole output block.
+    COUNT
+};
+
+//! Summary of a stage histogram; times in nanoseconds.
+struct AstageSummary
+{
+    uint64_t count;
+    double   min;
+    double   p50;
+    double   p90;
+    double   p99;
+    double   p999;
+    double   max;
+};
+
+/** Lock-free histogram of durations in nanoseconds.
+ *
+ *  Buckets are spaced logarithmically with eight buckets per power of two,
+ *  so percentiles are accurate to within about 12%. Minimum and maximum
+ *  are exact.
+ */
+class Ahistogram
+{
+public:
+    enum { SUB_BITS = 3, SUB = 1 << SUB_BITS, BUCKETS = (65 - SUB_BITS) * SUB };
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKETS> mBuckets;
+    std::atomic<uint64_t> mMin;
+    std::atomic<uint64_t> mMax;
+
+    static size_t   bucket(uint64_t ns);
+    static uint64_t lower (size_t bucket);
+
+public:
+    Ahistogram() { reset(); }
+
+    Ahistogram(const Ahistogram&) = delete;
+    Ahistogram& operator=(const Ahistogram&) = delete;
+
+    //! Adds a duration. Wait-free.
+    void record(uint64_t ns);
+
+    //! Clears every bucket. Durations recorded meanwhile may be lost.
+    void reset();
+
+    //! @return Count, percentiles and extremes of recorded durations.
+    AstageSummary summary() const;
+};
+
+/** Timing histograms of every render stage, shared by the whole process.
+ *
+ *  Stage timers record into it while it is enabled; it can be read at any
+ *  time through `summary` or written to the log with `dump`.
+ */
+class Aprofiler
+{
+private:
+    std::array<Ahistogram, static_cast<size_t>(Astage::COUNT)> mStages;
+    std::atomic<uint64_t>   mDeadline;  //!< Duration of one output block in nanoseconds.
+    std::atomic<bool>       mEnabled;
+
+    Aprofiler() : mStages(), mDeadline(0), mEnabled(false) { }
+
+public:
+    static Aprofiler& get();
+
+    //! @return Printable name of a stage.
+    static const char* name(Astage stage);
+
+    inline bool isEnabled() const { return mEnabled.load(std::memory_order_relaxed); }
+    inline void setEnabled(bool enabled) { mEnabled.store(enabled, std::memory_order_relaxed); }
+
+    //! Sets the block deadline from the output block size and sampling rate.
+    inline void setDeadline(size_t frames, size_t sample_rate)
+    {
+        mDeadline.store(sample_rate == 0 ? 0 : frames * UINT64_C(1000000000) / sample_rate,
+                std::memory_order_relaxed);
+    }
+
+    //! @return Duration of one output block in nanoseconds.
+    inline uint64_t getDeadline() const { return mDeadline.load(std::memory_order_relaxed); }
+
+    inline void record(Astage stage, uint64_t ns) { mStages[static_cast<size_t>(stage)].record(ns); }
+
+    inline AstageSummary summary(Astage stage) const { return mStages[static_cast<size_t>(stage)].summary(); }
+
+    //! Clears every stage histogram.
+    void reset();
+
+    /** Logs a summary line for each stage that has been timed, relative
+     *  to the block deadline. Does not lock or allocate.
+     */
+    void dump() const;
+};
+
+//! Times the enclosing scope into a stage histogram.
+class AstageTimer
+{
+private:
+    using clock = std::chrono::steady_clock;
+
+    Astage              mStage;
+    bool                mActive;
+    clock::time_point   mBegin;
+
+public:
+    inline explicit AstageTimer(Astage stage)
+        : mStage (stage)
+        , mActive(Aprofiler::get().isEnabled())
+        , mBegin (mActive ? clock::now() : clock::time_point())
+    { }
+
+    inline ~AstageTimer()
+    {
+        if (mActive)
+            Aprofiler::get().record(mStage, static_cast<uint64_t>(
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - mBegin).count()
+                        ));
+    }
+
+    AstageTimer(const AstageTimer&) = delete;
+    AstageTimer& operator=(const AstageTimer&) = delete;
+};
+
+}
+
+#define AWE_PROFILE_CAT_(a, b) a##b
+#define AWE_PROFILE_CAT(a, b) AWE_PROFILE_CAT_(a, b)
+
+/** Times the rest of the enclosing scope as the given stage, e.g.
+ *  `AWE_PROFILE_STAGE(RACK_FILTER);`
+ */
+#if AWE_PROFILE
+#define AWE_PROFILE_STAGE(stage) \
+    awe::AstageTimer AWE_PROFILE_CAT(awe_stage_timer_, __LINE__)(awe::Astage::stage)
+#else
+#define AWE_PROFILE_STAGE(stage) do { } while (0)
+#endif
+
+#endif
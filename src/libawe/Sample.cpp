@@ -0,0 +1,150 @@
+//  Sample.cpp :: Sound sample class
+//  Copyright 2012 - 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#include <algorithm>
+#include <cstdlib>
+#include "Arena.hpp"
+#include "Sample.hpp"
+
+namespace awe {
+
+size_t Asample::trim_silence(Afloat epsilon)
+{
+    if (mData == nullptr || mChannels == 0)
+        return 0;
+
+    // Buffer data is stored divided by the peak multiplier.
+    const Afloat limit  = epsilon / mSourcePeak * 32768.0f;
+    const size_t frames = mLength / mChannels;
+    const Aint*  data   = mData.get();
+
+    size_t end = frames;
+    for (; end > 1; end--) {
+        bool silent = true;
+
+        for (Achan c = 0; c < mChannels; c++) {
+            if (std::abs(data[(end - 1) * mChannels + c]) >= limit) {
+                silent = false;
+                break;
+            }
+        }
+
+        if (silent == false)
+            break;
+    }
+
+    if (end == frames)
+        return 0;
+
+    if (mSource == nullptr) {
+        // Arena slices cannot give memory back; only shorten the view.
+        mLength = end * mChannels;
+    } else if (mSource.use_count() > 2) { // Shared beyond this sample's own two references.
+        setSource(std::make_shared<AiBuffer>(data, data + end * mChannels), mSourcePeak);
+    } else {
+        mSource->resize(end * mChannels);
+        mSource->shrink_to_fit();
+        setSource(mSource, mSourcePeak);
+    }
+
+    return frames - end;
+}
+
+bool Asample::pack(Aarena &arena)
+{
+    if (mSource == nullptr)
+        return false;
+
+    std::shared_ptr<const Aint> slice = arena.copy(mData.get(), mLength);
+    if (slice == nullptr)
+        return false;
+
+    mSource.reset();
+    mData = slice;
+    return true;
+}
+
+bool Asample::widen()
+{
+#if AWE_FLOAT_SAMPLES
+    if (mData == nullptr)
+        return false;
+
+    std::shared_ptr<Afloat> data(new Afloat[mLength], std::default_delete<Afloat[]>());
+
+    const Aint* src = mData.get();
+    Afloat*     dst = data.get();
+    for (size_t i = 0; i < mLength; i++)
+        dst[i] = to_Afloat(src[i]) * mSourcePeak;
+
+    mSource.reset();
+    mData  .reset();
+    mFloat      = data;
+    mSourcePeak = 1.0f;
+    return true;
+#else
+    return false;
+#endif
+}
+
+uint64_t Asample::hash_content() const
+{
+    // 64-bit FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    auto feed = [&hash](const void* data, size_t size) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++)
+            hash = (hash ^ p[i]) * 0x100000001b3ULL;
+    };
+
+    feed(&mChannels  , sizeof(mChannels  ));
+    feed(&mSampleRate, sizeof(mSampleRate));
+    feed(&mSourcePeak, sizeof(mSourcePeak));
+
+    if (mData)
+        feed(mData.get(), mLength * sizeof(Aint));
+
+    if (mFloat)
+        feed(mFloat.get(), mLength * sizeof(Afloat));
+
+    if (mEncoded)
+        feed(mEncoded->data(), mEncoded->size());
+
+    return hash;
+}
+
+bool Asample::is_identical(const Asample &other) const
+{
+    if (mChannels   != other.mChannels   ||
+        mSampleRate != other.mSampleRate ||
+        mSourcePeak != other.mSourcePeak)
+        return false;
+
+    if (isStreamed() || other.isStreamed()) {
+        if (mEncoded == other.mEncoded)
+            return true;
+
+        if (isStreamed() != other.isStreamed())
+            return false;
+
+        return *mEncoded == *other.mEncoded;
+    }
+
+    if (mLength != other.mLength)
+        return false;
+
+    if (mData == other.mData && mFloat == other.mFloat)
+        return true;
+
+    if (mFloat || other.mFloat)
+        return mFloat && other.mFloat
+            && std::equal(mFloat.get(), mFloat.get() + mLength, other.mFloat.get());
+
+    if (mData == nullptr || other.mData == nullptr)
+        return false;
+
+    return std::equal(mData.get(), mData.get() + mLength, other.mData.get());
+}
+
+}
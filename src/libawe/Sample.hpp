@@ -5,10 +5,17 @@
 #define AWE_SAMPLE_H
 
 #include <memory>
+#include <string>
+#include <vector>
 #include "Define.hpp"
 
+struct SNDFILE_tag;
+
 namespace awe {
 
+struct awe_sf_vmio_data;
+class  Aarena;
+
 class Asample {
 private:
     /** Pointer to audio buffer data.
@@ -16,6 +23,27 @@ private:
      */
     std::shared_ptr<AiBuffer> mSource;
 
+    /** Pointer to the beginning of PCM data.
+     *  This points either into `mSource`, into a slice of an `Aarena`
+     *  shared with other samples or into memory held by someone else,
+     *  such as a mapped file, and keeps what it points into alive.
+     */
+    std::shared_ptr<const Aint> mData;
+    size_t          mLength;        //!< Number of PCM values at `mData` or `mFloat`.
+
+    /** Pointer to PCM data widened to floating point, with the peak
+     *  multiplier already applied. Samples holding this have no
+     *  16-bit data; see `widen`.
+     */
+    std::shared_ptr<const Afloat> mFloat;
+
+    /** Pointer to compressed audio data kept in place of the audio buffer.
+     *  Samples holding this are decoded with `AsampleDecoder` while they
+     *  play instead of being fully decoded on load.
+     */
+    std::shared_ptr<const std::vector<char> > mEncoded;
+    size_t          mEncodedFrames; //!< Number of frames in compressed audio data.
+
     Achan           mChannels;      //!< Number of channels on the source buffer.
 
     /** Audio buffer data peak gain applied before being sent to mixer.
@@ -31,7 +59,7 @@ private:
     std::string     mSampleName;    //!< Descriptive name of the sample.
 
 public:
-    Asample() : mSource(nullptr), mChannels(0), mSourcePeak(1.0f), mSampleRate(0), mSampleName("null") { }
+    Asample() : mSource(nullptr), mData(nullptr), mLength(0), mFloat(nullptr), mEncoded(nullptr), mEncodedFrames(0), mChannels(0), mSourcePeak(1.0f), mSampleRate(0), mSampleName("null") { }
 
     /** Default constructor
      *
@@ -46,6 +74,11 @@ public:
             const unsigned long &_rate,
             const std::string   &_name = "Unnamed sample"
     )   : mSource       (_source)
+        , mData         (_source ? std::shared_ptr<const Aint>(_source, _source->data()) : nullptr)
+        , mLength       (_source ? _source->size() : 0)
+        , mFloat        (nullptr)
+        , mEncoded      (nullptr)
+        , mEncodedFrames(0)
         , mChannels     (_chan)
         , mSourcePeak   (_peak)
         , mSampleRate   (_rate)
@@ -53,24 +86,41 @@ public:
     { }
 
     /** Load from file constructor.
+     *
+     *  \param stream_threshold Compressed samples longer than this many
+     *                          seconds are kept compressed; zero decodes
+     *                          every sample.
      *
      *  \warning This function blocks execution and leaves source as
      *           `nullptr` if it fails to load the sample from file.
      */
-    Asample(const std::string &file);
+    Asample(const std::string &file, double stream_threshold = 0.0);
 
     /** Load from memory constructor.
+     *
+     *  \param stream_threshold Compressed samples longer than this many
+     *                          seconds are kept compressed; zero decodes
+     *                          every sample.
      *
      *  \warning This function blocks execution and leaves source as
      *           `nullptr` if it fails to load the sample from memory.
      */
-    Asample(char* mptr, const size_t &size, const std::string &_name = "Unnamed sample");
+    Asample(
+        char const*          mptr,
+        const size_t        &size,
+        const std::string   &_name = "Unnamed sample",
+        double               stream_threshold = 0.0
+    );
 
     virtual ~Asample() { }
 
     inline bool drop() {
-        if (mSource) {
-            mSource.reset();
+        if (mData || mFloat || mEncoded) {
+            mSource .reset();
+            mData   .reset();
+            mFloat  .reset();
+            mLength = 0;
+            mEncoded.reset();
             return true;
         } else {
             return false;
@@ -86,20 +136,183 @@ public:
     inline void setSource(std::shared_ptr<AiBuffer> _source, Afloat _peak)
     {
         mSource     = _source;
+        mData       = _source ? std::shared_ptr<const Aint>(_source, _source->data()) : nullptr;
+        mLength     = _source ? _source->size() : 0;
+        mFloat      = nullptr;
+        mSourcePeak = _peak;
+    }
+
+    /** Assigns PCM data that is not held in an audio buffer, such as data
+     *  inside a mapped file. The pointer must keep the data alive, and
+     *  should have a use count of its own; see `isUnshared`.
+     *
+     *  \param _data   Interleaved 16-bit PCM data.
+     *  \param _length Number of PCM values at `_data`.
+     *  \param _peak   Audio buffer peak compensation multiplier.
+     */
+    inline void setData(std::shared_ptr<const Aint> _data, size_t _length, Afloat _peak)
+    {
+        mSource     = nullptr;
+        mData       = _data;
+        mLength     = _data ? _length : 0;
+        mFloat      = nullptr;
         mSourcePeak = _peak;
     }
 
+    /** Makes this sample play the same audio data as another sample.
+     *  Only the name of this sample is kept.
+     */
+    inline void share(const Asample &other)
+    {
+        mSource         = other.mSource;
+        mData           = other.mData;
+        mLength         = other.mLength;
+        mFloat          = other.mFloat;
+        mEncoded        = other.mEncoded;
+        mEncodedFrames  = other.mEncodedFrames;
+        mChannels       = other.mChannels;
+        mSourcePeak     = other.mSourcePeak;
+        mSampleRate     = other.mSampleRate;
+    }
+
+    /** Moves the PCM data of this sample into a slice of an arena.
+     *
+     *  The audio buffer is released once no other sample shares it.
+     *  Streamed samples and samples already inside an arena are left as
+     *  they are.
+     *
+     *  \return true if the data was moved.
+     */
+    bool pack(Aarena &arena);
+
+    /** Converts the PCM data of this sample to floating point and applies
+     *  the peak multiplier to it, so that it can be mixed without any
+     *  conversion. This doubles the memory used by the data.
+     *
+     *  Trimming, hashing and packing only work on 16-bit data; do those
+     *  first. Streamed samples are left as they are, and so is every
+     *  sample if `AWE_FLOAT_SAMPLES` is 0.
+     *
+     *  \return true if the data was converted.
+     */
+    bool widen();
+
+    /** Assigns compressed audio data to the sample in place of the audio
+     *  buffer.
+     *
+     *  \param _data   Compressed audio data.
+     *  \param _frames Number of frames in compressed audio data.
+     */
+    inline void setEncoded(std::shared_ptr<const std::vector<char> > _data, size_t _frames)
+    {
+        mSource         = nullptr;
+        mData           = nullptr;
+        mLength         = 0;
+        mFloat          = nullptr;
+        mEncoded        = _data;
+        mEncodedFrames  = _frames;
+        mSourcePeak     = 1.0f;
+    }
+
+    /** Retrieves the audio buffer owned by this sample.
+     *  \return nullptr if the sample has no PCM data or keeps it in an
+     *          arena; use `getData` to access PCM data in either case.
+     */
     inline std::shared_ptr<const AiBuffer> cgetSource() const { return mSource; }
     inline std::shared_ptr<      AiBuffer>  getSource()       { return mSource; }
 
+    inline std::shared_ptr<const Aint>      getData  () const { return mData;   }
+    inline std::shared_ptr<const Afloat>    getFloat () const { return mFloat;  }
+    inline size_t                           getLength() const { return mLength; }
+
+    /** Removes trailing frames quieter than a threshold.
+     *
+     *  The source buffer is copied first if it is shared with another
+     *  sample, so other owners keep seeing the untrimmed data.
+     *
+     *  \param epsilon Level, after peak compensation, below which a frame
+     *                 counts as silent.
+     *  \return Number of frames removed.
+     */
+    size_t trim_silence(Afloat epsilon = int16_normalized_epsilon);
+
+    /** Hashes the audio buffer content along with its channel count,
+     *  sampling rate and peak multiplier.
+     *
+     *  Samples with equal hashes are very likely to sound identical; use
+     *  `is_identical` to make sure.
+     */
+    uint64_t hash_content() const;
+
+    //! @return true if both samples hold identical audio data.
+    bool is_identical(const Asample &other) const;
+
+    inline std::shared_ptr<const std::vector<char> > cgetEncoded() const { return mEncoded; }
+
+    //! @return true if the sample holds either decoded or compressed audio data.
+    inline bool hasData    () const { return mData || mFloat || mEncoded; }
+
+    //! @return true if the sample is kept compressed and decoded while playing.
+    inline bool isStreamed () const { return mData == nullptr && mFloat == nullptr && mEncoded != nullptr; }
+
+    //! @return true if the PCM data of the sample is kept as floating point.
+    inline bool isWidened  () const { return mFloat != nullptr; }
+
+    /*! @return true if no other sample holds the audio buffer or
+     *          compressed data, so that dropping this sample frees it.
+     */
+    inline bool isUnshared() const {
+        // A heap buffer is held twice by its own sample: `mData` aliases `mSource`.
+        return mData  ? mData  .use_count() == (mSource ? 2 : 1)
+            :  mFloat ? mFloat .use_count() == 1
+            :  mEncoded.use_count() == 1;
+    }
+
+    //! @return Size of audio buffer or compressed data in bytes.
+    inline size_t getMemoryUsage() const {
+        return mData    ? mLength * sizeof(Aint)
+            :  mFloat   ? mLength * sizeof(Afloat)
+            :  mEncoded ? mEncoded->size()
+            :  0;
+    }
+
     inline Achan         getChannelCount() const { return mChannels; }
-    inline size_t        getFrameCount  () const { return mSource->size() / mChannels; }
+    inline size_t        getFrameCount  () const { return mData || mFloat ? mLength / mChannels : mEncodedFrames; }
     inline Afloat        getPeak        () const { return mSourcePeak; }
     inline unsigned long getSampleRate  () const { return mSampleRate; }
     inline std::string   getSampleName  () const { return mSampleName; }
     inline std::string   getName        () const { return mSampleName; }
 };
 
+/** Incremental decoder for samples kept compressed in memory.
+ *
+ *  Decodes the compressed data of a streamed sample a block at a time
+ *  as 32-bit float frames, at the sample's own sampling rate.
+ */
+class AsampleDecoder {
+private:
+    std::shared_ptr<const std::vector<char> > mData;
+
+    awe_sf_vmio_data*   mIO;
+    SNDFILE_tag*        mFile;
+    Achan               mChannels;
+
+public:
+    explicit AsampleDecoder(const Asample &sample);
+    ~AsampleDecoder();
+
+    AsampleDecoder(const AsampleDecoder&) = delete;
+    AsampleDecoder& operator=(const AsampleDecoder&) = delete;
+
+    inline bool  good           () const { return mFile != nullptr; }
+    inline Achan getChannelCount() const { return mChannels; }
+
+    /** Decodes the next block of frames.
+     *  \return Number of frames decoded; zero once the end is reached.
+     */
+    size_t read(Afloat* output, size_t frames);
+};
+
 }
 
 #endif
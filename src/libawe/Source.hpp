@@ -4,7 +4,7 @@
 #ifndef AWE_SOURCE_H
 #define AWE_SOURCE_H
 
-#include <set>
+#include <vector>
 #include "Define.hpp"
 
 namespace awe {
@@ -42,8 +42,8 @@ public:
     virtual void drop () = 0;
 };
 
-//! A set of sources.
-using AsourceSet = std::set<Asource*>;
+//! A flat list of sources, in the order they were added.
+using AsourceList = std::vector<Asource*>;
 
 }
 
@@ -1,7 +1,11 @@
 //  Sources/Track.cpp :: Sound mixing track
 //  Copyright 2012 - 2014 Chu Chin Kuan <keigen.shu@gmail.com>
 
+#include <algorithm>
+#include <iterator>
+#include <thread>
 #include "Track.hpp"
+#include "../Profile.hpp"
 
 namespace awe {
 namespace Source {
@@ -14,31 +18,135 @@ void Track::fpull(Asource* src)
 
 void Track::fpull()
 {
-    for(Asource* src: mPsources)
+    AWE_PROFILE_STAGE(TRACK_PULL);
+    SourceGuard sources(*this);
+    for(Asource* src: *sources)
         fpull(src);
 }
 
 void Track::fflip()
 {
-    auto s = mObuffer.size();
-    mObuffer.clear();
-    mObuffer.resize(s);
+    // The old output becomes the pool; only it needs clearing.
     mObuffer.swap(mPbuffer);
+    std::fill(mPbuffer.begin(), mPbuffer.end(), 0.0f);
 }
 
 void Track::ffilter()
 {
-    mOfilter.filter_buffer(mObuffer);
+    AWE_PROFILE_STAGE(RACK_FILTER);
+    mOfilter.filter_view(AscView::of(mObuffer, mLayout));
 }
 
 
-Track::Track(size_t sample_rate, size_t frames, std::string name)
+Track::Track(size_t sample_rate, size_t frames, std::string name, Alayout layout)
     : mName   (name)
-    , mPconfig(sample_rate, frames)
+    , mLayout (layout)
+    , mPconfig(sample_rate, frames, 0, ArenderConfig::Quality::DEFAULT, layout)
+    , mPsources(new AsourceList())
+    , mPepoch  (0)
+    , mPversion(0)
+    , mPretired()
     , mPbuffer(2 * frames, 0.f)
     , mObuffer(2 * frames, 0.f)
     , mqActive(true)
-{ }
+{
+    mPreaders[0] = 0;
+    mPreaders[1] = 0;
+}
+
+Track::~Track()
+{
+    for (AsourceList const* list : mPretired)
+        delete list;
+
+    delete mPsources.load();
+}
+
+void Track::publish(AsourceList const* sources)
+{
+    mPretired.push_back(mPsources.exchange(sources));
+    mPversion.fetch_add(1);
+    mqActive = !sources->empty();
+
+    // Guards taken from now on see the new list; with none held, nobody
+    // can be reading a replaced one.
+    if (mPreaders[0].load() == 0 && mPreaders[1].load() == 0)
+        reclaim(mPretired.size());
+}
+
+void Track::reclaim(size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        delete mPretired[i];
+
+    mPretired.erase(mPretired.begin(), mPretired.begin() + count);
+}
+
+void Track::attach_source(Asource* const src)
+{
+    MutexLockGuard s_lock(mSmutex);
+    AsourceList const &sources = *mPsources.load();
+
+    if (std::find(sources.begin(), sources.end(), src) != sources.end()) {
+        mqActive = true;
+        return;
+    }
+
+    AsourceList* list = new AsourceList();
+    list->reserve(sources.size() + 1);
+    list->assign(sources.begin(), sources.end());
+    list->push_back(src);
+
+    publish(list);
+}
+
+bool Track::detach_source(Asource* const src)
+{
+    uint64_t version;
+    {
+        MutexLockGuard s_lock(mSmutex);
+        AsourceList const &sources = *mPsources.load();
+
+        if (std::find(sources.begin(), sources.end(), src) == sources.end()) {
+            mqActive = !sources.empty();
+            return false;
+        }
+
+        AsourceList* list = new AsourceList();
+        list->reserve(sources.size() - 1);
+        std::remove_copy(sources.begin(), sources.end(), std::back_inserter(*list), src);
+
+        publish(list);
+        version = mPversion.load();
+    }
+
+    // A mix that loaded the old list may still render the source, and
+    // nothing reads the lists replaced so far once it is done.
+    synchronize();
+
+    // The list replaced by version `v` is retired as `v`; later writers
+    // may have freed or retired more meanwhile.
+    MutexLockGuard s_lock(mSmutex);
+    uint64_t const oldest = mPversion.load() - mPretired.size() + 1;
+    if (version >= oldest)
+        reclaim(static_cast<size_t>(version - oldest + 1));
+    return true;
+}
+
+void Track::synchronize() const
+{
+    MutexLockGuard q_lock(mQmutex);
+
+    // Guards counted after a flip load the list after it, so they cannot
+    // hold a list replaced before this call. The epoch is flipped twice,
+    // as a guard may read the epoch before a flip and count in it after.
+    for (int i = 0; i < 2; i++)
+    {
+        unsigned const epoch = mPepoch.fetch_add(1) & 1;
+        while (mPreaders[epoch].load() != 0)
+            std::this_thread::yield();
+    }
+}
 
 void Track::render(AfBuffer &targetBuffer, const ArenderConfig &targetConfig)
 {
@@ -47,9 +155,6 @@ void Track::render(AfBuffer &targetBuffer, const ArenderConfig &targetConfig)
 
     std::lock(mPmutex, mOmutex);
 
-    size_t a = 0, p = targetConfig.frameOffset;
-    size_t const  q = targetConfig.frameOffset + mPconfig.frameCount;
-
     MutexLockGuard o_lock(mOmutex, std::adopt_lock);
     {
         // Unlock pool mutex immediately after mixing.
@@ -63,17 +168,26 @@ void Track::render(AfBuffer &targetBuffer, const ArenderConfig &targetConfig)
     if (targetConfig.quality == ArenderConfig::Quality::MUTE)
         return;
 
-    AfBuffer::const_pointer src = mObuffer.data();
-    AfBuffer::      pointer dst = targetBuffer.data();
+    fmix(targetBuffer, targetConfig);
+}
 
-    while(p < q)
-    {
-        dst[p*2  ] += src[a*2  ];
-        dst[p*2+1] += src[a*2+1];
+void Track::fmix(AfBuffer &targetBuffer, const ArenderConfig &targetConfig) const
+{
+    AscCView const src = AscCView::of(mObuffer.data(), mObuffer.size() / 2, mLayout);
+    AscView  const dst = AscView ::of(targetBuffer, targetConfig.layout);
 
-        p += 1;
-        a += 1;
-    }
+    mix(src.slice(0, mPconfig.frameCount), dst.slice(targetConfig.frameOffset, mPconfig.frameCount));
+}
+
+void Track::take_output(AfBuffer &buffer)
+{
+    MutexLockGuard o_lock(mOmutex);
+
+    assert(buffer.size() == mObuffer.size());
+    if (mLayout == Alayout::INTERLEAVED)
+        mObuffer.swap(buffer);
+    else
+        copy(AscView::of(mObuffer, mLayout), AscView::interleaved(buffer));
 }
 
 }
@@ -4,13 +4,19 @@
 #ifndef AWE_SOURCE_TRACK_H
 #define AWE_SOURCE_TRACK_H
 
+#include <atomic>
 #include <mutex>
 #include <string>
+#include <vector>
 #include "../Define.hpp"
 #include "../Source.hpp"
+#include "../View.hpp"
 #include "../Filters/Rack.hpp"
 
 namespace awe {
+
+class ArenderGraph;
+
 namespace Source {
 
 /*! Sound mixer class.
@@ -22,28 +28,104 @@ namespace Source {
  *  All tracks are double-buffered; the internal inaccessible source
  *  mixing pool is labelled P while the output pool is labelled O.
  *
- *  Every track has two mutexes; one is used to lock the pool buffer,
- *  source list and pool config and the other is used to to lock the
- *  output buffer and filter rack.
+ *  Every track has two mutexes; one is used to lock the pool buffer
+ *  and pool config and the other is used to to lock the output buffer
+ *  and filter rack.
+ *
+ *  The source list is copied on write. Writers publish a new list with
+ *  one atomic exchange under a third mutex that mixing never takes, so
+ *  attaching or detaching a source does not stall a render. Readers hold
+ *  the list through a \ref SourceGuard, which does not lock; replaced
+ *  lists are freed by a later writer once no guard is held. Detaching a
+ *  source waits for such a moment, so that the source outlives any mix
+ *  that could still render it.
+ *
+ *  A track keeps its buffers in the layout it was made with. Sources
+ *  are told the layout through the pool config, and tracks of different
+ *  layouts can be mixed into each other; output handed over through
+ *  \ref take_output is always interleaved.
  */
 class Track : public Asource
 {
     using MutexLockGuard = std::lock_guard< std::mutex >;
     using AscRack        = Filter::Rack<2>;
 
+    //! Render graphs run the non-thread-safe methods on the tracks they hold.
+    friend class awe::ArenderGraph;
+
 private:
     mutable std::mutex  mPmutex;    //!< Track pool mutex
     mutable std::mutex  mOmutex;    //!< Track output mutex
+    mutable std::mutex  mSmutex;    //!< Source list writer mutex
+    mutable std::mutex  mQmutex;    //!< Grace period mutex
 
     std::string         mName;      //!< Track label (for identifying tracks)
+    Alayout const       mLayout;    //!< Layout of the pool and output buffers
     ArenderConfig       mPconfig;   //!< Track render configuration
 
-    AsourceSet  mPsources;  //!< Sound sources to mix from
+    std::atomic<AsourceList const*> mPsources;  //!< Sound sources to mix from; never modified once published
+    mutable std::atomic<unsigned>   mPreaders[2];   //!< Number of source guards held, by epoch
+    mutable std::atomic<unsigned>   mPepoch;        //!< Epoch new guards are counted in
+    std::atomic<uint64_t>           mPversion;  //!< Number of source lists published
+    std::vector<AsourceList const*> mPretired;  //!< Replaced source lists that guards may still hold
+
     AfBuffer    mPbuffer;   //!< Mixing buffer
     AfBuffer    mObuffer;   //!< Output buffer
     AscRack     mOfilter;   //!< Post-mixing filter rack
 
-    bool        mqActive;   //!< Is this source active?
+    std::atomic<bool>   mqActive;   //!< Is this source active?
+
+    /*! Publishes a new source list and frees replaced lists that are no
+     *  longer read. Must be called with the source list writer mutex.
+     */
+    void publish(AsourceList const* sources);
+
+    //! Frees the first `count` replaced source lists. Must be called
+    //! with the source list writer mutex.
+    void reclaim(size_t count);
+
+    /*! Counts a reader of the source list.
+     *  \return Epoch the reader is counted in; pass it to \ref leave.
+     */
+    inline unsigned enter() const
+    {
+        unsigned const epoch = mPepoch.load() & 1;
+        mPreaders[epoch].fetch_add(1);
+        return epoch;
+    }
+
+    //! Stops counting a reader counted by \ref enter.
+    inline void leave(unsigned epoch) const { mPreaders[epoch].fetch_sub(1); }
+
+public:
+    /*! Wait-free read access to the source list of a track. The list
+     *  stays valid, and unchanged, until the guard is destroyed.
+     */
+    class SourceGuard
+    {
+    private:
+        Track const &       mTrack;
+        unsigned const      mEpoch;
+        AsourceList const*  mList;
+
+    public:
+        explicit SourceGuard(Track const &track)
+            : mTrack(track)
+            , mEpoch(track.enter())
+        {
+            // Count this reader before loading, so that a writer seeing
+            // no readers knows that nobody holds the list it replaced.
+            mList = mTrack.mPsources.load();
+        }
+
+        ~SourceGuard() { mTrack.leave(mEpoch); }
+
+        SourceGuard(const SourceGuard&) = delete;
+        SourceGuard& operator=(const SourceGuard&) = delete;
+
+        inline AsourceList const& operator* () const { return *mList; }
+        inline AsourceList const* operator->() const { return  mList; }
+    };
 
 private:
     //!\name Non-thread-safe methods
@@ -61,10 +143,22 @@ private:
     //! Apply filter rack onto output buffer, without mutex lock.
     void ffilter();
 
+    //! Add output buffer onto a target buffer, without mutex lock.
+    void fmix(AfBuffer &targetBuffer, const ArenderConfig &targetConfig) const;
+
     //!\}
 
 public:
-    Track(size_t sample_rate, size_t frames, std::string name = "Unnamed Track");
+    Track(
+        size_t sample_rate,
+        size_t frames,
+        std::string name = "Unnamed Track",
+        Alayout layout = Alayout::INTERLEAVED
+    );
+    virtual ~Track();
+
+    Track(const Track&) = delete;
+    Track& operator=(const Track&) = delete;
 
     /*! This call does nothing on a track object.
      *  \warning This call does not drop any of the source and filter
@@ -78,8 +172,8 @@ public:
      */
     virtual void make_active(void*) override
     {
-        MutexLockGuard p_lock(mPmutex);
-        mqActive = !mPsources.empty();
+        SourceGuard sources(*this);
+        mqActive = !sources->empty();
     }
 
     /*! Queries whether or not this track is up and running.
@@ -87,7 +181,6 @@ public:
      */
     virtual bool is_active() const override
     {
-        MutexLockGuard p_lock(mPmutex);
         return mqActive;
     }
 
@@ -100,15 +193,20 @@ public:
     inline const ArenderConfig& getConfig() const { return mPconfig; }
 
     /*! Sets the source pool renderer configuration structure of this
-     *  track.
+     *  track. The layout of a track cannot change; that of the new
+     *  configuration is ignored.
      *  \param new_config the new configuration to use in this track.
      */
     inline void setConfig(const ArenderConfig &new_config)
     {
         MutexLockGuard p_lock(mPmutex);
         mPconfig = new_config;
+        mPconfig.layout = mLayout;
     }
 
+    //! @return Layout of the output buffer, and of what sources render into.
+    inline Alayout getLayout() const { return mLayout; }
+
     /*! Retrieves the output mutex object which controls the output
      *  buffer and the rack.
      *  \return a reference to the output mutex of this track.
@@ -122,11 +220,12 @@ public:
     inline std::string const & getName() { return mName; }
 
     /*! Retrieves the source list that this track buffers data from.
-     *  \return a read-only reference to the source list of this track.
+     *  \return a copy of the source list of this track; hold a
+     *          \ref SourceGuard instead to read it without copying.
      */
-    inline const AsourceSet& getSources() const { return mPsources; }
+    inline AsourceList getSources() const { return *SourceGuard(*this); }
 
-    /*! Retrieves the track output buffer.
+    /*! Retrieves the track output buffer, laid out as \ref getLayout.
      *  \warning Ownership of this object is defined by the output
      *           mutex obtainable through the \ref getMutex() call.
      *  \return a reference to the output buffer of this track.
@@ -145,9 +244,9 @@ public:
      */
     inline size_t count_active_sources() const
     {
-        MutexLockGuard p_lock(mPmutex);
+        SourceGuard sources(*this);
         size_t count = 0;
-        for(Asource const * src : mPsources)
+        for(Asource const * src : *sources)
         {
             if (src->is_active() == true)
                 count++;
@@ -155,37 +254,39 @@ public:
         return count;
     }
 
+    /*! Counts changes to the source list, so that a copy of its
+     *  layout can tell when to update.
+     *  \return number of source lists published so far.
+     */
+    inline uint64_t getVersion() const { return mPversion.load(); }
+
     /*! Counts the number of sources assigned to the source pool.
      *  \return number of sources within the pooling list
      */
     inline size_t count_sources() const {
-        MutexLockGuard p_lock(mPmutex);
-        return mPsources.size();
+        return SourceGuard(*this)->size();
     }
 
-    /*! Inserts a source into the pooling list.
+    /*! Inserts a source into the pooling list. Does not wait for the
+     *  track to finish mixing.
      *  \param src[in] pointer to the source object to be inserted.
      */
-    inline void attach_source(Asource* const src)
-    {
-        MutexLockGuard p_lock(mPmutex);
-        if (mPsources.count(src) == 0)
-            mPsources.insert(src);
-
-        mqActive = true;
-    }
+    void attach_source(Asource* const src);
 
-    /*! Removes a source from the pooling list.
+    /*! Removes a source from the pooling list, then waits for mixes
+     *  still reading the old list to finish; see \ref synchronize. The
+     *  source may be freed once this returns.
+     *  \warning Must not be called while holding a \ref SourceGuard on,
+     *           or rendering, this track.
      *  \return false if the no objects were deleted from the pooling
      *          list.
      */
-    inline bool detach_source(Asource* const src)
-    {
-        MutexLockGuard p_lock(mPmutex);
-        bool r = mPsources.erase(src) != 0;
-        mqActive = !mPsources.empty();
-        return r;
-    }
+    bool detach_source(Asource* const src);
+
+    /*! Waits until no \ref SourceGuard is held on this track, so that
+     *  nothing is still reading a source list replaced before the call.
+     */
+    void synchronize() const;
 
     //! Pull assigned sources into pool buffer, with mutex lock.
     inline void pull()
@@ -217,16 +318,14 @@ public:
         ffilter();
     }
 
-    /*! Pushes the output buffer into a queue buffer.
-     *  \param queue[out] FIFO buffer to write the output buffer to
+    /*! Hands the output over as interleaved frames into a buffer of
+     *  the same size, e.g. a block of the output queue. Interleaved
+     *  output is exchanged with the buffer without copying, and holds
+     *  the buffer's old contents until the next flip; planar output is
+     *  interleaved into it.
+     *  \param buffer[in,out] buffer to hand the output over to
      */
-    inline void push(AfFIFOBuffer &queue) const
-    {
-        MutexLockGuard o_lock(mOmutex);
-
-        for(auto s : mObuffer)
-            queue.push(s);
-    }
+    void take_output(AfBuffer &buffer);
 
 };
 
@@ -0,0 +1,65 @@
+//  View.cpp :: Non-owning views over blocks of samples
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#include "View.hpp"
+
+namespace awe {
+
+void scale(AscView const &view, Asfloatf const &gain)
+{
+#if AWE_SSE2
+    if (view.isInterleaved()) {
+        Afloat* const x = view.channel(0);
+        size_t  const n = view.frames() * 2;
+        size_t        i = 0;
+
+        __m128 const g = _mm_setr_ps(gain.data[0], gain.data[1], gain.data[0], gain.data[1]);
+        for (; i + 4 <= n; i += 4)
+            _mm_storeu_ps(x + i, _mm_mul_ps(_mm_loadu_ps(x + i), g));
+
+        if (i < n) {
+            x[i    ] *= gain.data[0];
+            x[i + 1] *= gain.data[1];
+        }
+        return;
+    }
+#endif
+    scale<2>(view, gain);
+}
+
+void measure(AscView const &view, Asfloatf &peak, Asfloatf &power)
+{
+#if AWE_SSE2
+    if (view.isInterleaved()) {
+        Afloat const* const x = view.channel(0);
+        size_t        const n = view.frames() * 2;
+        size_t              i = 0;
+
+        __m128 const sign = _mm_set1_ps(-0.0f);
+        __m128 p = _mm_setzero_ps();
+        __m128 s = _mm_setzero_ps();
+        for (; i + 4 <= n; i += 4) {
+            __m128 const v = _mm_loadu_ps(x + i);
+            p = _mm_max_ps(p, _mm_andnot_ps(sign, v));
+            s = _mm_add_ps(s, _mm_mul_ps(v, v));
+        }
+
+        // Fold the second frame of each register onto the first.
+        p = _mm_max_ps(p, _mm_movehl_ps(p, p));
+        s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+
+        if (i < n) {
+            __m128 const v = Asfloatf::load(x + i);
+            p = _mm_max_ps(p, _mm_andnot_ps(sign, v));
+            s = _mm_add_ps(s, _mm_mul_ps(v, v));
+        }
+
+        Asfloatf::store(peak .data.data(), p);
+        Asfloatf::store(power.data.data(), s);
+        return;
+    }
+#endif
+    measure<2>(view, peak, power);
+}
+
+}
@@ -0,0 +1,218 @@
+//  View.hpp :: Non-owning views over blocks of samples
+//  Copyright 2014 Chu Chin Kuan <keigen.shu@gmail.com>
+
+#ifndef AWE_VIEW_H
+#define AWE_VIEW_H
+
+#include <algorithm>
+#include "Define.hpp"
+#include "Frame.hpp"
+
+namespace awe {
+
+/*! Non-owning view over a block of frames.
+ *
+ *  A view does not care how samples are laid out in memory: sample `c` of
+ *  frame `i` is found at `i * step + c * span` elements from the start.
+ *  An interleaved buffer has a step of `Channels` and a span of 1; a
+ *  planar block has a step of 1 and a span of its length in frames.
+ *
+ *  Views are cheap to copy and are passed to filters by value, so that a
+ *  filter can work through a whole block, or a slice of it, without
+ *  copying frames in and out of the buffer.
+ *
+ *  @tparam T type of samples viewed; const for a read-only view.
+ *  @tparam Channels number of channels in every frame.
+ */
+template< typename T, Achan Channels >
+class Aview
+{
+private:
+    T*      mData;
+    size_t  mFrames;
+    size_t  mStep;  //!< Elements from one frame to the next.
+    size_t  mSpan;  //!< Elements from one channel to the next.
+
+public:
+    static constexpr Achan _channels = Channels;
+
+    Aview(T* data, size_t frames, size_t step, size_t span)
+        : mData(data), mFrames(frames), mStep(step), mSpan(span)
+    { }
+
+    //! Views `frames` interleaved frames starting at `data`.
+    static inline Aview interleaved(T* data, size_t frames) {
+        return Aview(data, frames, Channels, 1);
+    }
+
+    //! Views the whole of an interleaved buffer.
+    static inline Aview interleaved(Abuffer<T> &buffer) {
+        return interleaved(buffer.data(), buffer.size() / Channels);
+    }
+
+    //! Views `frames` frames stored channel after channel from `data`.
+    static inline Aview planar(T* data, size_t frames) {
+        return Aview(data, frames, 1, frames);
+    }
+
+    //! Views `frames` frames from `data` laid out as given.
+    static inline Aview of(T* data, size_t frames, Alayout layout) {
+        return (layout == Alayout::PLANAR)
+            ? planar     (data, frames)
+            : interleaved(data, frames);
+    }
+
+    //! Views the whole of a buffer laid out as given.
+    static inline Aview of(Abuffer<T> &buffer, Alayout layout) {
+        return of(buffer.data(), buffer.size() / Channels, layout);
+    }
+
+    //! Views the frames of a buffer that a render configuration targets.
+    static inline Aview target(Abuffer<T> &buffer, ArenderConfig const &config) {
+        return of(buffer, config.layout).slice(config.frameOffset, config.frameCount);
+    }
+
+    inline size_t frames() const { return mFrames; }
+    inline size_t step  () const { return mStep;   }
+    inline size_t span  () const { return mSpan;   }
+
+    inline Alayout layout() const { return isPlanar() ? Alayout::PLANAR : Alayout::INTERLEAVED; }
+
+    inline bool isInterleaved() const { return mStep == Channels && mSpan == 1; }
+    inline bool isPlanar     () const { return mStep == 1; }
+
+    //! @return Pointer to the first sample of a channel; step through it by `step()`.
+    inline T* channel(Achan c) const { return mData + c * mSpan; }
+
+    inline T& at(size_t frame, Achan c) const {
+        assert(frame < mFrames && c < Channels);
+        return mData[frame * mStep + c * mSpan];
+    }
+
+    //! @return Copy of a frame.
+    inline Aframe<T, Channels> frame(size_t i) const {
+        Aframe<T, Channels> f;
+        for (Achan c = 0; c < Channels; c += 1)
+            f.data[c] = at(i, c);
+        return f;
+    }
+
+    inline void frame(size_t i, Aframe<T, Channels> const &f) const {
+        for (Achan c = 0; c < Channels; c += 1)
+            at(i, c) = f.data[c];
+    }
+
+    //! @return View of `count` frames from frame `first`, clipped to this view.
+    inline Aview slice(size_t first, size_t count) const {
+        first = std::min(first, mFrames);
+        return Aview(mData + first * mStep, std::min(count, mFrames - first), mStep, mSpan);
+    }
+};
+
+using AscView  = Aview<Afloat      , 2>;  //!< a view over stereo Afloat frames
+using AscCView = Aview<Afloat const, 2>;  //!< a read-only view over stereo Afloat frames
+
+//!@name Block kernels
+//!@{
+
+//  Element-wise kernels keep a separate loop for planar views: with a
+//  step of one known at compile time, the compiler vectorizes them.
+
+//! Multiplies every sample by the gain of its channel.
+template< Achan Channels >
+void scale(Aview<Afloat, Channels> const &view, Aframe<Afloat, Channels> const &gain)
+{
+    for (Achan c = 0; c < Channels; c += 1) {
+        Afloat* const x = view.channel(c);
+        Afloat  const g = gain.data[c];
+        if (view.isPlanar()) {
+            for (size_t i = 0; i < view.frames(); i += 1)
+                x[i] *= g;
+        } else {
+            for (size_t i = 0; i < view.frames(); i += 1)
+                x[i * view.step()] *= g;
+        }
+    }
+}
+
+/*! Measures every channel of a block.
+ *  @param[out] peak  largest magnitude of each channel.
+ *  @param[out] power sum of the squares of each channel.
+ */
+template< Achan Channels >
+void measure(Aview<Afloat, Channels> const &view, Aframe<Afloat, Channels> &peak, Aframe<Afloat, Channels> &power)
+{
+    for (Achan c = 0; c < Channels; c += 1) {
+        Afloat const* const x = view.channel(c);
+        Afloat p = 0.0f, s = 0.0f;
+        for (size_t i = 0; i < view.frames(); i += 1) {
+            Afloat const v = x[i * view.step()];
+            p  = std::max(p, std::fabs(v));
+            s += v * v;
+        }
+        peak .data[c] = p;
+        power.data[c] = s;
+    }
+}
+
+/*! Adds every sample of a block onto another, whatever the layout of
+ *  either; frames past the end of the shorter one are left alone.
+ */
+template< typename S, Achan Channels >
+void mix(Aview<S, Channels> const &src, Aview<Afloat, Channels> const &dst)
+{
+    size_t const n = std::min(src.frames(), dst.frames());
+
+    if (src.isInterleaved() && dst.isInterleaved()) {
+        Afloat const* const x = src.channel(0);
+        Afloat      * const y = dst.channel(0);
+        for (size_t i = 0; i < n * Channels; i += 1)
+            y[i] += x[i];
+        return;
+    }
+
+    for (Achan c = 0; c < Channels; c += 1) {
+        Afloat const* const x = src.channel(c);
+        Afloat      * const y = dst.channel(c);
+        if (src.isPlanar() && dst.isPlanar()) {
+            for (size_t i = 0; i < n; i += 1)
+                y[i] += x[i];
+        } else {
+            for (size_t i = 0; i < n; i += 1)
+                y[i * dst.step()] += x[i * src.step()];
+        }
+    }
+}
+
+/*! Copies a block into another, e.g. to interleave a planar block;
+ *  frames past the end of the shorter one are left alone.
+ */
+template< typename S, Achan Channels >
+void copy(Aview<S, Channels> const &src, Aview<Afloat, Channels> const &dst)
+{
+    size_t const n = std::min(src.frames(), dst.frames());
+
+    if (src.isInterleaved() && dst.isInterleaved()) {
+        std::copy(src.channel(0), src.channel(0) + n * Channels, dst.channel(0));
+        return;
+    }
+
+    for (Achan c = 0; c < Channels; c += 1) {
+        Afloat const* const x = src.channel(c);
+        Afloat      * const y = dst.channel(c);
+        for (size_t i = 0; i < n; i += 1)
+            y[i * dst.step()] = x[i * src.step()];
+    }
+}
+
+//! Stereo \ref scale, two frames at a time on interleaved blocks.
+void scale(AscView const &view, Asfloatf const &gain);
+
+//! Stereo \ref measure, two frames at a time on interleaved blocks.
+void measure(AscView const &view, Asfloatf &peak, Asfloatf &power);
+
+//!@}
+
+}
+
+#endif
@@ -2,7 +2,9 @@
 //  Copyright 2012 - 2013 Keigen Shu
 
 #include "awePortAudio.hpp"
+#include "Log.hpp"
 
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
 
@@ -25,24 +27,23 @@ static int PaCallback(
     (void) inputBuffer;
     (void) timeInfo;
 
-    if (statusFlags == paOutputUnderflow) {
+    /* The stream primes and starts before the first block is published;
+     * running dry until then is not an underrun. */
+    bool const started = data->output->started();
+
+    bool const underflow = statusFlags == paOutputUnderflow;
+    if (underflow)
         data->underflows++;
-    }
+
+    size_t const done = data->output->read(out, framesPerBuffer);
 
     /* Library failed to update sooner. */
-    if (data->output->size() < framesPerBuffer * 2) {
-        for (unsigned int i = 0; i < framesPerBuffer; i++) {
-            *out++ = 0;
-            *out++ = 0;
-        }
-    } else {
-        data->mutex->lock();
-        for (unsigned int i = 0; i < framesPerBuffer; i++) {
-            *out++ = data->output->front(); data->output->pop();
-            *out++ = data->output->front(); data->output->pop();
-        }
-        data->mutex->unlock();
-    }
+    if (done < framesPerBuffer)
+        std::fill(out + done * 2, out + framesPerBuffer * 2, 0.0f);
+
+    /* Count one underrun per callback, whichever side ran dry. */
+    if (started && (underflow || done < framesPerBuffer))
+        data->underruns.fetch_add(1, std::memory_order_relaxed);
 
     data->calls++;
     return 0;
@@ -52,11 +53,25 @@ static int PaCallback(
 bool APortAudio::init(
     unsigned int sample_rate,
     unsigned int frame_count,
-    HostAPIType device_type
+    HostAPIType device_type,
+    size_t queue_blocks
 )
 {
     mSampleRate = sample_rate;
     mFrameRate  = frame_count;
+    mNull       = device_type == HostAPIType::Null;
+    mPAostream  = NULL;
+
+    mOutputQueue.resize(queue_blocks, frame_count);
+
+    if (mNull) {
+        mPAerror              = paNoError;
+        mPApacket.output      = &mOutputQueue;
+        mPApacket.calls       = 0;
+        mPApacket.underflows  = 0;
+        mPApacket.underruns   = 0;
+        return true;
+    }
 
     mPAerror = Pa_Initialize();
     if (test_error()) {
@@ -84,10 +99,10 @@ bool APortAudio::init(
         return false;
     }
 
-    mPApacket.mutex       = &mOutputMutex;
     mPApacket.output      = &mOutputQueue;
     mPApacket.calls       = 0;
     mPApacket.underflows  = 0;
+    mPApacket.underruns   = 0;
 
     mPAostream_params.channelCount = 2;  /* Stereo output. */
     mPAostream_params.sampleFormat = paFloat32;
@@ -123,33 +138,95 @@ bool APortAudio::test_error() const
     return false;
 }
 
-unsigned short int APortAudio::fplay(AfBuffer const& buffer)
+bool APortAudio::fplay(AfBuffer const& buffer)
 {
-    mOutputMutex.lock();
+    AfBuffer* block = mOutputQueue.acquire();
+    if (block == nullptr)
+        return false;
 
-    for (Afloat const & smp : buffer) {
-        mOutputQueue.push(smp);
-    }
+    std::copy(buffer.begin(), buffer.begin() + std::min(buffer.size(), block->size()), block->begin());
+    mOutputQueue.publish();
 
     if (mPApacket.underflows != 0) {
-        fprintf(stdout, "PortAudio [warn] %u device underflows(s) on last update.\n", mPApacket.underflows);
+        AWE_LOG(WARN, "PortAudio", "%u device underflows(s) on last update.", mPApacket.underflows);
     }
     if (mPApacket.calls > 1) {
-        fprintf(stdout, "PortAudio [warn] %u libawe underflows(s) on last update.\n", mPApacket.calls - 1);
+        AWE_LOG(WARN, "PortAudio", "%u libawe underflows(s) on last update.", mPApacket.calls - 1);
     }
 
     mPApacket.calls = 0;
     mPApacket.underflows = 0;
 
-    mOutputMutex.unlock();
+    return true;
+}
 
-    return 0;
+bool APortAudio::supports(unsigned int sample_rate) const
+{
+    if (mNull)
+        return true;
+
+    return Pa_IsFormatSupported(NULL, &mPAostream_params, sample_rate) == paFormatIsSupported;
+}
+
+bool APortAudio::reopen(unsigned int sample_rate)
+{
+    if (sample_rate == mSampleRate)
+        return true;
+
+    if (mNull) {
+        mOutputQueue.reset();
+        mSampleRate = sample_rate;
+        return true;
+    }
+
+    // Errors are handled here; test_error() would terminate PortAudio.
+    Pa_StopStream (mPAostream);
+    Pa_CloseStream(mPAostream);
+    mPAostream = NULL;
+
+    // The stream is stopped, so nothing reads the queue.
+    mOutputQueue.reset();
+    mPApacket.calls      = 0;
+    mPApacket.underflows = 0;
+
+    for (unsigned int rate : { sample_rate, mSampleRate })
+    {
+        mPAerror = Pa_OpenStream(
+                       &mPAostream, NULL,
+                       &mPAostream_params,
+                       rate, mFrameRate,
+                       paPrimeOutputBuffersUsingStreamCallback, PaCallback,
+                       &mPApacket
+                   );
+
+        if (mPAerror == paNoError) {
+            mPAerror = Pa_StartStream(mPAostream);
+
+            if (mPAerror == paNoError) {
+                mSampleRate = rate;
+                return rate == sample_rate;
+            }
+
+            Pa_CloseStream(mPAostream);
+            mPAostream = NULL;
+        }
+
+        fprintf(stderr, "PortAudio [error] Could not open stream at %u Hz. %d : %s \n",
+                rate, mPAerror, Pa_GetErrorText(mPAerror));
+    }
+
+    return false;
 }
 
 void APortAudio::shutdown()
 {
-    mPAerror = Pa_StopStream(mPAostream);
-    mPAerror = Pa_CloseStream(mPAostream);
+    if (mNull)
+        return;
+
+    if (mPAostream != NULL) {
+        mPAerror = Pa_StopStream(mPAostream);
+        mPAerror = Pa_CloseStream(mPAostream);
+    }
 
     Pa_Terminate();
 
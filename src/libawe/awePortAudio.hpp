@@ -5,8 +5,9 @@
 #define AWE_PORTAUDIO_H
 
 #include <portaudio.h>
-#include <mutex>
+#include <atomic>
 #include "Define.hpp"
+#include "BlockRing.hpp"
 
 namespace awe {
 
@@ -18,10 +19,10 @@ public:
     //! PortAudio callback data structure.
     struct PaCallbackPacket
     {
-        std::mutex  *   mutex;      //<! Output FIFO buffer mutex.
-        AfFIFOBuffer*   output;     //<! Output FIFO buffer pointer.
+        AblockRing  *   output;     //<! Output block queue.
         unsigned char   calls;      //<! Number of times PA ran this callback since last update.
         unsigned char   underflows; //<! Number of times PA reported underflow problems since last update.
+        std::atomic<unsigned long> underruns; //<! Underflows and callbacks short of data since the stream was opened; not counted before the first block of a (re)started stream.
     };
 
     //! PortAudio audio output host API enumerator
@@ -39,7 +40,12 @@ public:
         WDMKS   = paWDMKS,
         JACK    = paJACK,
         WASAPI  = paWASAPI,
-        ASHPI   = paAudioScienceHPI
+        ASHPI   = paAudioScienceHPI,
+
+        /*! No device. Output is left in the output queue for the caller
+         *  to take, for rendering offline or measuring the engine.
+         */
+        Null    = -1
     };
 
 private:
@@ -48,11 +54,11 @@ private:
     PaStreamParameters  mPAostream_params;
     PaCallbackPacket    mPApacket;
 
-    AfFIFOBuffer        mOutputQueue;
-    std::mutex          mOutputMutex;
+    AblockRing          mOutputQueue;
 
     unsigned int    mSampleRate;
     unsigned int    mFrameRate;
+    bool            mNull;      //!< Running without a device.
 
     //! Checks if PortAudio has an error
     bool test_error() const;
@@ -61,21 +67,48 @@ public:
     inline unsigned char pa_calls           () const { return mPApacket.calls; }
     inline double        pa_stream_cpu_load () const { return Pa_GetStreamCpuLoad(mPAostream); }
     inline double        pa_stream_time     () const { return Pa_GetStreamTime   (mPAostream); }
-    inline AfFIFOBuffer& getFIFOBuffer      ()       { return mOutputQueue; }
-    inline std::mutex  & getFIFOBuffer_mutex()       { return mOutputMutex; }
+
+    /*! Retrieves the queue of blocks waiting to be played. The caller
+     *  fills and publishes blocks; the device reads them.
+     */
+    inline AblockRing  & getQueue           ()       { return mOutputQueue; }
 
     inline unsigned int  getSampleRate() const { return mSampleRate; }
     inline unsigned int  getFrameRate () const { return mFrameRate ; }
+    inline bool          isNull       () const { return mNull; }
+
+    //! @returns number of underruns since the output was opened.
+    inline unsigned long getUnderruns () const { return mPApacket.underruns.load(std::memory_order_relaxed); }
 
-    //! Plays provided buffer. @returns underruns since last play.
-    unsigned short int fplay(const AfBuffer& buffer);
+    /*! Queues a copy of the provided buffer of one block.
+     *  @returns false if the queue is full.
+     */
+    bool fplay(const AfBuffer& buffer);
 
+    /*! Drops every queued block, as a device would play them; for use
+     *  with `Null` output.
+     *  @returns number of frames dropped.
+     */
+    inline size_t drain() { return mOutputQueue.discard(); }
+
+    /*! \param queue_blocks Number of blocks the output queue can hold.
+     */
     bool init(
             unsigned int sample_rate,
             unsigned int frame_count,
-            HostAPIType device_type = HostAPIType::Default
+            HostAPIType device_type = HostAPIType::Default,
+            size_t queue_blocks = 2
             );
     void shutdown();
+
+    //! @returns true if the output device can run at the given sampling rate.
+    bool supports(unsigned int sample_rate) const;
+
+    /*! Reopens the output stream at another sampling rate, discarding
+     *  any queued output. The previous rate is restored on failure.
+     *  @returns true if the stream now runs at the given sampling rate.
+     */
+    bool reopen(unsigned int sample_rate);
 };
 }
 #endif
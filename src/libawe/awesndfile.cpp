@@ -1,6 +1,7 @@
 //  awesndfile.cpp :: Audio file reader via libsndfile
 //  Copyright 2012 - 2014 Chu Chin Kuan <keigen.shu@gmail.com>
 
+#include <cstdio>
 #include <exception>
 #include "awesndfile.hpp"
 #include "Sample.hpp"
@@ -107,24 +108,29 @@ sf_count_t awe_sf_vmio_read(void* ptr, sf_count_t count, void* user_data)
 
 sf_count_t awe_sf_vmio_write(const void* ptr, sf_count_t count, void* user_data)
 {
-    awe_sf_vmio_data* io = (awe_sf_vmio_data*) user_data;
-    sf_count_t realcount = 0;
-    char* sptr = (char*) ptr;
+    // Memory sources are read-only.
+    (void) ptr;
+    (void) count;
+    (void) user_data;
 
-    for (sf_count_t i = 0; i < count; i++) {
-        if (io->curr < io->size) {
-            io->mptr[io->curr] = sptr[i];
-            io->curr++;
-            realcount++;
-        }
-    }
+    return 0;
+}
 
-    return realcount;
+/* only compressed formats are worth keeping in memory undecoded */
+static bool is_compressed(const SF_INFO* info)
+{
+    return (info->format & SF_FORMAT_SUBMASK ) == SF_FORMAT_VORBIS
+        || (info->format & SF_FORMAT_TYPEMASK) == SF_FORMAT_FLAC;
 }
 
 // Asample constructors
-Asample::Asample(const std::string& file)
+Asample::Asample(const std::string& file, double stream_threshold)
     : mSource(nullptr)
+    , mData(nullptr)
+    , mLength(0)
+    , mFloat(nullptr)
+    , mEncoded(nullptr)
+    , mEncodedFrames(0)
     , mChannels(0)
     , mSourcePeak(1.0)
     , mSampleRate(0)
@@ -148,16 +154,46 @@ Asample::Asample(const std::string& file)
     mChannels   = info->channels;
     mSampleRate = info->samplerate;
 
+    if (stream_threshold > 0.0 && is_compressed(info) && info->frames > stream_threshold * info->samplerate) {
+        // Keep the file contents instead of decoding them.
+        FILE* fp = fopen(file.c_str(), "rb");
+        if (fp != nullptr) {
+            fseek(fp, 0, SEEK_END);
+            long size = ftell(fp);
+            fseek(fp, 0, SEEK_SET);
+
+            auto data = std::make_shared< std::vector<char> >(size > 0 ? size : 0);
+            if (size > 0 && fread(data->data(), 1, size, fp) == static_cast<size_t>(size)) {
+                mEncoded       = data;
+                mEncodedFrames = info->frames;
+            }
+
+            fclose(fp);
+        }
+
+        if (mEncoded) {
+            sf_close(sndf);
+            delete info;
+            return;
+        }
+    }
+
     read_sndfile(this, sndf, info);
 
     return;
 }
 
 Asample::Asample(
-    char*               mptr,
+    char const*         mptr,
     const size_t&       size,
-    const std::string& _name
+    const std::string& _name,
+    double              stream_threshold
 )   : mSource(nullptr)
+    , mData(nullptr)
+    , mLength(0)
+    , mFloat(nullptr)
+    , mEncoded(nullptr)
+    , mEncodedFrames(0)
     , mChannels(0)
     , mSourcePeak(1.0)
     , mSampleRate(0)
@@ -182,10 +218,62 @@ Asample::Asample(
 
     mChannels   = info->channels;
     mSampleRate = info->samplerate;
-    
+
+    if (stream_threshold > 0.0 && is_compressed(info) && info->frames > stream_threshold * info->samplerate) {
+        // Keep a copy of the compressed data instead of decoding it.
+        mEncoded       = std::make_shared< const std::vector<char> >(mptr, mptr + size);
+        mEncodedFrames = info->frames;
+
+        sf_close(sndf);
+        delete info;
+        return;
+    }
+
     read_sndfile(this, sndf, info);
 
     return;
 }
 
+// Asample decoder
+AsampleDecoder::AsampleDecoder(const Asample &sample)
+    : mData     (sample.cgetEncoded())
+    , mIO       (nullptr)
+    , mFile     (nullptr)
+    , mChannels (0)
+{
+    if (mData == nullptr)
+        return;
+
+    mIO = new awe_sf_vmio_data { 0, static_cast<sf_count_t>(mData->size()), mData->data() };
+
+    SF_INFO info = SF_INFO();
+    SNDFILE* sndf = sf_open_virtual(&awe_sf_vmio, SFM_READ, &info, (void*) mIO);
+
+    if (sf_error(sndf) != SF_ERR_NO_ERROR) {
+        fprintf(stderr, "libsndfile [error] %s: %s.\n", sample.getName().c_str(), sf_strerror(sndf));
+        sf_close(sndf);
+        return;
+    }
+
+    mFile     = sndf;
+    mChannels = info.channels;
+}
+
+AsampleDecoder::~AsampleDecoder()
+{
+    if (mFile != nullptr)
+        sf_close(mFile);
+
+    delete mIO;
+}
+
+size_t AsampleDecoder::read(Afloat* output, size_t frames)
+{
+    if (mFile == nullptr)
+        return 0;
+
+    sf_count_t done = sf_readf_float(mFile, output, frames);
+    return done > 0 ? static_cast<size_t>(done) : 0;
+}
+
 }
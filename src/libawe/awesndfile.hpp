@@ -16,7 +16,7 @@ namespace awe
 struct awe_sf_vmio_data {
     sf_count_t  curr;                                       //!< current offset
     sf_count_t  size;                                       //!< file size
-    char*       mptr;                                       //!< Pointer to beginning of data
+    char const* mptr;                                       //!< Pointer to beginning of data
 };
 
 sf_count_t awe_sf_vmio_get_filelen(void* user_data);